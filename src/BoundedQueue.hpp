@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Fila bloqueante com capacidade máxima, para ligar produtores e consumidores de imagens.
+ * close() sinaliza que não haverá mais itens: pop() retorna false quando a fila estiver vazia e fechada.
+ */
+template<typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lk(m);
+        cv_push.wait(lk, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        cv_pop.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lk(m);
+        cv_pop.wait(lk, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        cv_push.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(m);
+        closed = true;
+        cv_pop.notify_all();
+    }
+
+   protected:
+    const size_t capacity;
+    std::deque<T> items;
+    std::mutex m;
+    std::condition_variable cv_push, cv_pop;
+    bool closed = false;
+};
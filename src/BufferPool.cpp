@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <sys/mman.h>
+#include "BufferPool.hpp"
+#include "benchmark.hpp"
+
+bool BufferPool::enabled = false;
+size_t BufferPool::capacity = size_t(1) << 30;
+
+static const size_t HUGE_PAGE = 2 << 20;
+
+namespace {
+struct Block {
+    size_t bytes, alignment;
+};
+std::mutex mutex;
+std::unordered_map<void*, Block> live;        // Buffers entregues
+std::multimap<size_t, std::pair<void*, Block>> idle; // Buffers guardados, por tamanho
+size_t held = 0;
+BufferPool::Stats totals;
+}  // namespace
+
+void *BufferPool::acquire(size_t bytes, size_t alignment, bool huge_pages) {
+    BenchClock clock;
+    if (huge_pages) {
+        alignment = std::max(alignment, HUGE_PAGE);
+        bytes = (bytes + HUGE_PAGE - 1)/HUGE_PAGE*HUGE_PAGE;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (enabled) {
+        // Aceita um buffer guardado de até o dobro do tamanho pedido
+        for (auto it = idle.lower_bound(bytes); it != idle.end() && it->first <= 2*bytes; ++it) {
+            if (it->second.second.alignment < alignment) continue;
+            void *p = it->second.first;
+            live.emplace(p, it->second.second);
+            held -= it->first;
+            idle.erase(it);
+            totals.reuses++;
+            totals.time += clock.getElapsed();
+            return p;
+        }
+    }
+    lock.unlock();
+
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, bytes) != 0) throw std::bad_alloc();
+    if (huge_pages) madvise(p, bytes, MADV_HUGEPAGE);
+
+    lock.lock();
+    live.emplace(p, Block{bytes, alignment});
+    totals.allocations++;
+    totals.time += clock.getElapsed();
+    return p;
+}
+
+void BufferPool::release(void *p) {
+    if (!p) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto it = live.find(p);
+    if (it != live.end()) {
+        const Block b = it->second;
+        live.erase(it);
+        if (enabled && held + b.bytes <= capacity) {
+            idle.emplace(b.bytes, std::make_pair(p, b));
+            held += b.bytes;
+            return;
+        }
+    }
+    lock.unlock();
+    std::free(p);
+}
+
+void BufferPool::count(uint64_t allocations, int64_t time) {
+    std::lock_guard<std::mutex> lock(mutex);
+    totals.allocations += allocations;
+    totals.time += time;
+}
+
+BufferPool::Stats BufferPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals;
+}
+
+void BufferPool::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    totals = Stats();
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& i : idle) std::free(i.second.first);
+    idle.clear();
+    held = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Reserva dos buffers de imagem, reaproveitados entre imagens, iterações e layouts.
+ * Com `enabled`, buffers liberados ficam guardados (até `capacity` bytes) e atendem pedidos de tamanho compatível,
+ * evitando as faltas de página e o munmap/mmap de cada alocação grande; as imagens Pointers passam a ocupar uma
+ * única laje contígua (tabelas e linhas). Desabilitada, acquire/release equivalem a posix_memalign/free.
+ * Em ambos os casos a quantidade e o tempo das alocações são contabilizados.
+ */
+struct BufferPool {
+    struct Stats {
+        uint64_t allocations = 0; // Alocações pedidas ao sistema
+        uint64_t reuses = 0;      // Pedidos atendidos por buffers guardados
+        int64_t time = 0;         // Tempo gasto alocando, em CLOCK_PRECISION
+    };
+
+    static bool enabled;
+    static size_t capacity;
+
+    /**
+     * Buffer de pelo menos `bytes` bytes alinhado a `alignment` (potência de dois). huge_pages: alinha a 2 MiB,
+     * arredonda o tamanho e pede páginas grandes (madvise).
+     */
+    static void *acquire(size_t bytes, size_t alignment, bool huge_pages = false);
+    static void release(void *p);
+
+    /**
+     * Contabiliza alocações feitas fora da reserva (linhas individuais dos Pointers sem a reserva).
+     */
+    static void count(uint64_t allocations, int64_t time);
+
+    static Stats stats();
+    static void resetStats();
+
+    /**
+     * Devolve ao sistema todos os buffers guardados.
+     */
+    static void trim();
+};
@@ -1,9 +1,22 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #define cimg_display 0
 #include "include/CImg.h"
 #include "Image3D.hpp"
+#include "BufferPool.hpp"
+#include "Numa.hpp"
+#include "benchmark.hpp"
+#include "ImageConvert.hpp"
 
 const std::string _PixelOrder_getRepr(const PixelOrder& i) {
-    std::string arr[] = {"XYC", "XCY", "YXC", "YCX", "CXY", "CYX"};
+    std::string arr[] = {"XYC", "XCY", "YXC", "YCX", "CXY", "CYX", "TILE8", "MORTON"};
     return arr[int(i)];
 }
 
@@ -12,80 +25,274 @@ struct OrderStorage {
     OrderStorage _obj(uint f, uint s, uint t) { return {f, s, t}; }
 };
 
-template<PixelOrder order, bool memblock>
-void Image3D<order, memblock>::init(uint w, uint a, uint c) {
+std::string RawCache::dir;
+size_t RowPitch::alignment = 0;
+bool RowPitch::huge_pages = false;
+
+std::string RawCache::path(const char *file, const std::string& implementation, bool forceDefaultChannels) {
+    if (dir.empty()) return "";
+    std::string name(file);
+    for (auto& ch : name) if (ch == '/') ch = '_';
+    return dir + "/" + name + "." + implementation + (forceDefaultChannels ? ".3c" : "") + ".i3d";
+}
+
+/**
+ * Cabeçalho dos arquivos do RawCache. O tamanho e a data de modificação do arquivo de origem invalidam o cache.
+ * Os pixels começam em `payload_offset`, alinhado à página, de modo que o buffer mapeado também fique alinhado.
+ */
+struct RawHeader {
+    char magic[4];
+    uint32_t version, width, height, channels, order, pixel_size;
+    int64_t src_size, src_mtime;
+    uint64_t payload_offset;
+};
+static const char RAW_MAGIC[4] = {'I', '3', 'D', 'R'};
+static const uint32_t RAW_VERSION = 1;
+
+template<PixelOrder order, bool memblock, typename T>
+void Image3D<order, memblock, T>::setDimensions(uint w, uint a, uint c) {
     width = w;
     height = a;
     channels = c;
-    OrderStorage o;
-    auto _soorder = at_order<OrderStorage, OrderStorage*>(&o, width, height, channels);
-    _dfw = _soorder.first;
-    _dsh = _soorder.second;
-    _dtc = _soorder.third;
-    // _dsh_X__dtc = _dsh*_dtc;
-    if (_dfw*_dsh*_dtc == 0) return;
+    if constexpr (order == PixelOrder::TILE8) {
+        _blk = (w + 7)/8;
+        _dfw = w && a ? _blk*((a + 7)/8) : 0;
+        _dsh = 64;
+        _dtc = c;
+    } else if constexpr (order == PixelOrder::MORTON) {
+        const auto bits = [](uint n) { uint b = 0; while ((uint64_t(1) << b) < n) b++; return b; };
+        const uint bx = bits(w), by = bits(a);
+        const uint64_t total = w && a ? uint64_t(1) << (bx + by) : 0;
+        _blk = std::min(bx, by);
+        _dsh = std::min<uint64_t>(64, total);
+        _dfw = _dsh ? total/_dsh : 0;
+        _dtc = c;
+    } else {
+        OrderStorage o;
+        auto _soorder = at_order<OrderStorage, OrderStorage*>(&o, width, height, channels);
+        _dfw = _soorder.first;
+        _dsh = _soorder.second;
+        _dtc = _soorder.third;
+    }
+    _ss = _dtc;
+    _sf = size_t(_dsh)*_dtc;
+}
+
+template<PixelOrder order, bool memblock, typename T>
+void Image3D<order, memblock, T>::init(uint w, uint a, uint c) {
+    setDimensions(w, a, c);
+    if (size_t(_dfw)*_dsh*_dtc == 0) return;
 
     if constexpr (memblock) {
-        buff = new pixel_unit[_dfw*_dsh*_dtc];
+        const size_t align = RowPitch::alignment/sizeof(pixel_unit);
+        if (align > 1 && !_PixelOrder_isBlocked(order)) {
+            const auto pad = [&](size_t n) {
+                n = (n + align - 1)/align*align;
+                return (n*sizeof(pixel_unit)) % 4096 == 0 ? n + align : n;
+            };
+            if constexpr (order == PixelOrder::XYC || order == PixelOrder::YXC) {
+                _sf = pad(size_t(_dsh)*_dtc); // Linhas de pixels intercalados
+            } else {
+                _ss = pad(_dtc);              // A terceira coordenada (x ou y) forma as linhas
+                _sf = _dsh*_ss;
+            }
+        }
+        const size_t alignment = std::max(RowPitch::alignment, alignof(std::max_align_t));
+        buff = static_cast<pixel_unit*>(BufferPool::acquire(_dfw*_sf*sizeof(pixel_unit), alignment, RowPitch::huge_pages));
+        Numa::place(buff, _dfw*_sf*sizeof(pixel_unit), _dfw);
+    } else if (BufferPool::enabled) {
+        // Uma única laje: tabela da primeira coordenada, tabelas da segunda e, alinhadas, as linhas
+        const size_t tables = (_dfw + size_t(_dfw)*_dsh)*sizeof(void*), pixels_at = (tables + 63)/64*64;
+        slab = BufferPool::acquire(pixels_at + size_t(_dfw)*_dsh*_dtc*sizeof(pixel_unit), 64);
+        buff = reinterpret_cast<pixel_unit***>(slab);
+        pixel_unit **rows = reinterpret_cast<pixel_unit**>(buff + _dfw);
+        pixel_unit *p = reinterpret_cast<pixel_unit*>(static_cast<char*>(slab) + pixels_at);
+        for (uint c = 0; c < _dfw; c++, rows += _dsh) {
+            buff[c] = rows;
+            for (uint i = 0; i < _dsh; i++, p += _dtc)
+                buff[c][i] = p;
+        }
     } else {
+        BenchClock clock;
         buff = new pixel_unit **[_dfw];
         for (uint c = 0; c < _dfw; c++) {
             buff[c] = new pixel_unit *[_dsh];
             for (uint i = 0; i < _dsh; i++)
                 buff[c][i] = new pixel_unit[_dtc];
         }
+        BufferPool::count(1 + _dfw + size_t(_dfw)*_dsh, clock.getElapsed());
     }
 }
 
-template<PixelOrder order, bool memblock>
-Image3D<order, memblock>::Image3D(uint width, uint height, uint channels) {
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::Image3D(uint width, uint height, uint channels) {
     init(width, height, channels);
 }
 
-template<PixelOrder order, bool memblock>
-Image3D<order, memblock>::Image3D(const char *file, bool forceDefaultChannels) {
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::Image3D(pixel_unit *external, uint width, uint height, uint channels) {
+    if constexpr (memblock) {
+        setDimensions(width, height, channels);
+        buff = external;
+        owner = false;
+    } else {
+        assert(!"Vistas externas exigem um buffer contíguo (MemBlock)");
+        init(0, 0, 0);
+    }
+}
+
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::Image3D(const Image3D& other) : Image3D(other.width, other.height, other.channels) {
+    convert::image(other, *this);
+}
+
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::Image3D(Image3D&& other) : width(other.width), height(other.height), channels(other.channels),
+        _dfw(other._dfw), _dsh(other._dsh), _dtc(other._dtc), _sf(other._sf), _ss(other._ss), _blk(other._blk), buff(other.buff),
+        mapping(other.mapping), mapping_size(other.mapping_size), owner(other.owner), slab(other.slab) {
+    other.owner = false; // O buffer agora pertence a esta imagem
+    other.mapping = other.slab = nullptr;
+}
+
+template<PixelOrder order, bool memblock, typename T>
+bool Image3D<order, memblock, T>::loadRaw(const std::string& path, int64_t src_size, int64_t src_mtime) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    RawHeader hd;
+    struct stat st;
+    bool valid = ::read(fd, &hd, sizeof(hd)) == sizeof(hd) && std::memcmp(hd.magic, RAW_MAGIC, 4) == 0 &&
+                 hd.version == RAW_VERSION && hd.order == uint32_t(order) && hd.pixel_size == sizeof(pixel_unit) &&
+                 hd.src_size == src_size && hd.src_mtime == src_mtime && fstat(fd, &st) == 0;
+    // Os layouts em blocos guardam também o preenchimento dos blocos, então o tamanho vem das dimensões internas
+    if (valid) setDimensions(hd.width, hd.height, hd.channels);
+    const size_t n = valid ? size_t(_dfw)*_dsh*_dtc : 0;
+    if (!valid || uint64_t(st.st_size) != hd.payload_offset + n*sizeof(pixel_unit) || n == 0) {
+        close(fd);
+        return false;
+    }
+    if constexpr (memblock) {
+        // MAP_PRIVATE: escritas na imagem não alteram o cache
+        void *m = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) return false;
+        mapping = m;
+        mapping_size = st.st_size;
+        buff = reinterpret_cast<pixel_unit*>(static_cast<char*>(m) + hd.payload_offset);
+    } else {
+        // Sem buffer contíguo para mapear: lê os pixels (já na ordem do layout) e os distribui pelas linhas
+        std::vector<pixel_unit> payload(n);
+        const bool ok = pread(fd, payload.data(), n*sizeof(pixel_unit), hd.payload_offset) == ssize_t(n*sizeof(pixel_unit));
+        close(fd);
+        if (!ok) return false;
+        init(hd.width, hd.height, hd.channels);
+        const pixel_unit *p = payload.data();
+        for (uint f = 0; f < _dfw; f++)
+            for (uint i = 0; i < _dsh; i++, p += _dtc)
+                std::memcpy(buff[f][i], p, _dtc*sizeof(pixel_unit));
+    }
+    return true;
+}
+
+template<PixelOrder order, bool memblock, typename T>
+void Image3D<order, memblock, T>::saveRaw(const std::string& path, int64_t src_size, int64_t src_mtime) const {
+    RawHeader hd;
+    std::memset(&hd, 0, sizeof(hd));
+    std::memcpy(hd.magic, RAW_MAGIC, 4);
+    hd.version = RAW_VERSION;
+    hd.width = width;
+    hd.height = height;
+    hd.channels = channels;
+    hd.order = uint32_t(order);
+    hd.pixel_size = sizeof(pixel_unit);
+    hd.src_size = src_size;
+    hd.src_mtime = src_mtime;
+    hd.payload_offset = std::max<long>(sysconf(_SC_PAGESIZE), sizeof(hd));
+
+    // Escreve em um arquivo temporário e renomeia, para que leitores concorrentes nunca vejam um arquivo parcial
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    FILE *fp = std::fopen(tmp.c_str(), "wb");
+    if (!fp) return;
+    bool ok = std::fwrite(&hd, sizeof(hd), 1, fp) == 1 && std::fseek(fp, hd.payload_offset, SEEK_SET) == 0;
+    if (isPacked() && memblock) {
+        const size_t n = size_t(_dfw)*_dsh*_dtc;
+        ok = ok && std::fwrite(data(), sizeof(pixel_unit), n, fp) == n;
+    } else {
+        // O arquivo é sempre compacto: escreve sequência a sequência, sem o preenchimento
+        for (uint f = 0; f < _dfw && ok; f++)
+            for (uint i = 0; i < _dsh && ok; i++)
+                ok = std::fwrite(&_obj(f, i, 0), sizeof(pixel_unit), _dtc, fp) == _dtc;
+    }
+    ok = std::fclose(fp) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) std::remove(tmp.c_str());
+}
+
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::Image3D(const char *file, bool forceDefaultChannels) {
+    const std::string cache = RawCache::path(file, __implementation_type(), forceDefaultChannels);
+    struct stat src;
+    const bool cacheable = !cache.empty() && stat(file, &src) == 0;
+    if (cacheable && loadRaw(cache, src.st_size, src.st_mtime)) return;
+
     cimg_library::CImg<pixel_unit> image(file);
+    if constexpr (std::is_floating_point<T>::value) image /= image.max() > 255 ? 65535 : 255;
     init(image.width(), image.height(), forceDefaultChannels ? 3 : image.spectrum());
 
-    cimg_forXYC(image,x,y,c) {
-        if (c < int(channels)) {
-            at(x, y, c) = image(x,y,c);
+    if (image.depth() == 1 && int(channels) <= image.spectrum()) {
+        // O buffer da CImg é planar (MemBlock@CYX): cópia direta ou conversão em blocos
+        const Image3D<PixelOrder::CYX, true, T> planar(image.data(), width, height, channels);
+        convert::image(planar, *this);
+    } else {
+        cimg_forXYC(image,x,y,c) {
+            if (c < int(channels)) {
+                at(x, y, c) = image(x,y,c);
+            }
         }
     }
+    if (cacheable) saveRaw(cache, src.st_size, src.st_mtime);
 }
 
-template<PixelOrder order, bool memblock>
-Image3D<order, memblock>::~Image3D() {
-    if (_dfw*_dsh*_dtc == 0) return;
+template<PixelOrder order, bool memblock, typename T>
+Image3D<order, memblock, T>::~Image3D() {
+    if (!owner) return;
+    if (mapping) {
+        munmap(mapping, mapping_size);
+        return;
+    }
+    if (size_t(_dfw)*_dsh*_dtc == 0) return;
 
-    if constexpr (!memblock) {
+    if constexpr (memblock) {
+        BufferPool::release(buff);
+    } else if (slab) {
+        BufferPool::release(slab);
+    } else {
         for (uint c = 0; c < _dfw; c++) {
             for (uint i = 0; i < _dsh; i++)
                 delete[] (buff[c][i]);
             delete[] buff[c];
         }
+        delete[] buff;
     }
-    delete[] buff;
 }
 
 
-template<PixelOrder order, bool memblock>
-void Image3D<order, memblock>::save(const char *const file) const {
+template<PixelOrder order, bool memblock, typename T>
+void Image3D<order, memblock, T>::save(const char *const file) const {
     cimg_library::CImg<pixel_unit> image(width, height, 1, channels);
-    cimg_forXYC(image,x,y,c) {
-        image(x,y,c) = at(x, y, c);
-    }
+    Image3D<PixelOrder::CYX, true, T> planar(image.data(), width, height, channels);
+    convert::image(*this, planar);
+    if constexpr (std::is_floating_point<T>::value) image *= 255;
     image.save(file);
 }
 
-template<PixelOrder order, bool memblock>
-void Image3D<order, memblock>::print() const {
+template<PixelOrder order, bool memblock, typename T>
+void Image3D<order, memblock, T>::print() const {
     //printf("lxa: %ux%u\n", i2d->width, i2d->height);
     for (uint x = 0; x < width; x++) {
         for (uint y = 0; y < height; y++) {
             printf("(");
             for (uint c = 0; c < channels; c++) {
-                printf(c == 0 ? "%02hhX" : ",%02hhX", at(x, y, c));
+                if constexpr (std::is_floating_point<T>::value) printf(c == 0 ? "%.3f" : ",%.3f", double(at(x, y, c)));
+                else printf(c == 0 ? "%0*X" : ",%0*X", int(2*sizeof(T)), uint(at(x, y, c)));
             }
             printf(") ");
         }
@@ -94,15 +301,51 @@ void Image3D<order, memblock>::print() const {
     printf("\n");
 }
 
-template class Image3D<PixelOrder::XYC, false>;
-template class Image3D<PixelOrder::XYC, true>;
-template class Image3D<PixelOrder::XCY, false>;
-template class Image3D<PixelOrder::XCY, true>;
-template class Image3D<PixelOrder::YXC, false>;
-template class Image3D<PixelOrder::YXC, true>;
-template class Image3D<PixelOrder::YCX, false>;
-template class Image3D<PixelOrder::YCX, true>;
-template class Image3D<PixelOrder::CXY, false>;
-template class Image3D<PixelOrder::CXY, true>;
-template class Image3D<PixelOrder::CYX, false>;
-template class Image3D<PixelOrder::CYX, true>;
+template class Image3D<PixelOrder::XYC, false, uint8_t>;
+template class Image3D<PixelOrder::XYC, true, uint8_t>;
+template class Image3D<PixelOrder::XCY, false, uint8_t>;
+template class Image3D<PixelOrder::XCY, true, uint8_t>;
+template class Image3D<PixelOrder::YXC, false, uint8_t>;
+template class Image3D<PixelOrder::YXC, true, uint8_t>;
+template class Image3D<PixelOrder::YCX, false, uint8_t>;
+template class Image3D<PixelOrder::YCX, true, uint8_t>;
+template class Image3D<PixelOrder::CXY, false, uint8_t>;
+template class Image3D<PixelOrder::CXY, true, uint8_t>;
+template class Image3D<PixelOrder::CYX, false, uint8_t>;
+template class Image3D<PixelOrder::CYX, true, uint8_t>;
+template class Image3D<PixelOrder::TILE8, false, uint8_t>;
+template class Image3D<PixelOrder::TILE8, true, uint8_t>;
+template class Image3D<PixelOrder::MORTON, false, uint8_t>;
+template class Image3D<PixelOrder::MORTON, true, uint8_t>;
+template class Image3D<PixelOrder::XYC, false, uint16_t>;
+template class Image3D<PixelOrder::XYC, true, uint16_t>;
+template class Image3D<PixelOrder::XCY, false, uint16_t>;
+template class Image3D<PixelOrder::XCY, true, uint16_t>;
+template class Image3D<PixelOrder::YXC, false, uint16_t>;
+template class Image3D<PixelOrder::YXC, true, uint16_t>;
+template class Image3D<PixelOrder::YCX, false, uint16_t>;
+template class Image3D<PixelOrder::YCX, true, uint16_t>;
+template class Image3D<PixelOrder::CXY, false, uint16_t>;
+template class Image3D<PixelOrder::CXY, true, uint16_t>;
+template class Image3D<PixelOrder::CYX, false, uint16_t>;
+template class Image3D<PixelOrder::CYX, true, uint16_t>;
+template class Image3D<PixelOrder::TILE8, false, uint16_t>;
+template class Image3D<PixelOrder::TILE8, true, uint16_t>;
+template class Image3D<PixelOrder::MORTON, false, uint16_t>;
+template class Image3D<PixelOrder::MORTON, true, uint16_t>;
+template class Image3D<PixelOrder::XYC, false, float>;
+template class Image3D<PixelOrder::XYC, true, float>;
+template class Image3D<PixelOrder::XCY, false, float>;
+template class Image3D<PixelOrder::XCY, true, float>;
+template class Image3D<PixelOrder::YXC, false, float>;
+template class Image3D<PixelOrder::YXC, true, float>;
+template class Image3D<PixelOrder::YCX, false, float>;
+template class Image3D<PixelOrder::YCX, true, float>;
+template class Image3D<PixelOrder::CXY, false, float>;
+template class Image3D<PixelOrder::CXY, true, float>;
+template class Image3D<PixelOrder::CYX, false, float>;
+template class Image3D<PixelOrder::CYX, true, float>;
+template class Image3D<PixelOrder::TILE8, false, float>;
+template class Image3D<PixelOrder::TILE8, true, float>;
+template class Image3D<PixelOrder::MORTON, false, float>;
+template class Image3D<PixelOrder::MORTON, true, float>;
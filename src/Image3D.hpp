@@ -1,29 +1,123 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
 #include <string>
+#include <type_traits>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
 #define RED 0
 #define GREEN 1
 #define BLUE 2
 #define ALPHA 3
 
+/**
+ * As seis permutações lineares de x, y e c, mais dois layouts em blocos de 64 pixels com os canais intercalados:
+ * TILE8, com tiles de 8x8 (tiles e pixels de cada tile em ordem de linhas), e MORTON, com os pixels em ordem Z
+ * (bits de x e y intercalados, sobre a imagem com largura e altura arredondadas para potências de dois).
+ * Nos dois últimos, (primeira, segunda, terceira) = (bloco, pixel no bloco, canal).
+ */
 enum class PixelOrder : unsigned {
-    XYC, XCY, YXC, YCX, CXY, CYX
+    XYC, XCY, YXC, YCX, CXY, CYX, TILE8, MORTON
 };
 
 const std::string _PixelOrder_getRepr(const PixelOrder& i);
 
+constexpr bool _PixelOrder_isBlocked(PixelOrder o) { return o == PixelOrder::TILE8 || o == PixelOrder::MORTON; }
+
+/**
+ * Índice Z de (x, y): os k bits baixos de x e y intercalados (x nos pares) e, acima deles, os bits restantes da
+ * coordenada maior (a menor já cabe em k bits).
+ */
+constexpr inline uint64_t _morton_index(uint x, uint y, uint k) {
+    const uint mask = (uint64_t(1) << k) - 1;
+#ifdef __BMI2__
+    if (!__builtin_is_constant_evaluated())
+        return _pdep_u64(x & mask, 0x5555555555555555ull) | _pdep_u64(y & mask, 0xAAAAAAAAAAAAAAAAull) | (uint64_t((x >> k) | (y >> k)) << 2*k);
+#endif
+    const auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        return (v | (v << 1)) & 0x5555555555555555ull;
+    };
+    return spread(x & mask) | (spread(y & mask) << 1) | (uint64_t((x >> k) | (y >> k)) << 2*k);
+}
+
 typedef unsigned char default_pixel_unit;
 
+/**
+ * Tipos de pixel suportados por Image3D: uint8_t (padrão), uint16_t e float.
+ * white: intensidade máxima (as imagens float são normalizadas em [0, 1]);
+ * grad: tipo dos gradientes de Sobel; sum: tipo das somas de janelas do blur;
+ * bins: classes dos histogramas (um valor por classe nos inteiros; [0, 1] quantizado em 256 classes no float);
+ * name: sufixo do nome das implementações e das linhas do benchmark.
+ */
+template<typename T> struct PixelTraits;
+template<> struct PixelTraits<uint8_t> {
+    static constexpr uint8_t white = 255;
+    typedef int grad;
+    typedef uint32_t sum;
+    static constexpr uint bins = 256;
+    static constexpr const char *name = "u8";
+};
+template<> struct PixelTraits<uint16_t> {
+    static constexpr uint16_t white = 65535;
+    typedef int grad;
+    typedef uint64_t sum;
+    static constexpr uint bins = 65536;
+    static constexpr const char *name = "u16";
+};
+template<> struct PixelTraits<float> {
+    static constexpr float white = 1;
+    typedef float grad;
+    typedef double sum;
+    static constexpr uint bins = 256;
+    static constexpr const char *name = "f32";
+};
+
+/**
+ * Cache em disco de imagens já convertidas para um layout (arquivos .i3d: cabeçalho + pixels na ordem do layout).
+ * Quando `dir` não é vazio, o construtor a partir de arquivo procura a imagem no cache antes de decodificá-la;
+ * imagens MemBlock são mapeadas (mmap) diretamente como buffer, sem decodificação nem cópia (e portanto compactas,
+ * independentemente de RowPitch).
+ */
+struct RawCache {
+    static std::string dir;
+    static std::string path(const char *file, const std::string& implementation, bool forceDefaultChannels);
+};
+
+/**
+ * Passo das linhas dos buffers MemBlock alocados a partir de agora. Com `alignment` > 0 (bytes), o buffer e cada
+ * linha (a sequência contígua de pixels: ao longo de x em YXC/YCX/CYX e de y em XYC/XCY/CXY) começam
+ * alinhados, com um preenchimento invisível a at(); passos múltiplos de 4 KiB ganham mais `alignment` bytes,
+ * evitando que as linhas vizinhas dos estênceis caiam no mesmo conjunto da cache.
+ * huge_pages: alinha o buffer a 2 MiB e pede páginas grandes ao kernel (madvise).
+ */
+struct RowPitch {
+    static size_t alignment; // 0: linhas compactadas (padrão)
+    static bool huge_pages;
+};
+
 #define __I3D__obj_assert(f, s, t) assert(f < _dfw); assert(s < _dsh); assert(t < _dtc);
-#define __I3D__obj_calc(f, s, t) __I3D__obj_assert(f, s, t); if constexpr (memblock) { return buff[f*_dsh*_dtc + s*_dtc + t]; } else { return buff[f][s][t]; }
+#define __I3D__obj_calc(f, s, t) __I3D__obj_assert(f, s, t); if constexpr (memblock) { return buff[f*_sf + s*_ss + t]; } else { return buff[f][s][t]; }
 
-template<PixelOrder order, bool memblock>
+template<PixelOrder order, bool memblock, typename T = default_pixel_unit>
 struct Image3D {
-    typedef default_pixel_unit pixel_unit;
+    typedef T pixel_unit;
+    static constexpr PixelOrder pixel_order = order;
+    static constexpr bool is_memblock = memblock;
    protected:
-    template<typename R, typename T>
-    static constexpr inline R at_order(T t, uint first, uint second, uint third) { 
+    template<typename R, typename Self>
+    static constexpr inline R at_order(Self t, uint first, uint second, uint third) { 
+        if constexpr (order == PixelOrder::TILE8) {
+            return t->_obj((second >> 3)*t->_blk + (first >> 3), ((second & 7) << 3) | (first & 7), third);
+        } else if constexpr (order == PixelOrder::MORTON) {
+            const uint64_t m = _morton_index(first, second, t->_blk);
+            return t->_obj(m >> 6, m & 63, third);
+        }
         switch (order) {
             default:
             case PixelOrder::XYC: return t->_obj(first, second, third);
@@ -36,27 +130,38 @@ struct Image3D {
     }
 
     uint width, height, channels;
-    uint _dfw, _dsh, _dtc; // TODO: Test _dsh_X__dtc (i.e., the precomputed product of _dsh and _dtc);
+    uint _dfw, _dsh, _dtc;
+    size_t _sf, _ss; // Passos (em elementos) da primeira e da segunda coordenada no MemBlock; a terceira é contígua
+    uint _blk = 0;   // TILE8: tiles por linha; MORTON: bits intercalados de x e y
 
     template <bool b>
     using BufferType = typename std::conditional<b, pixel_unit*, pixel_unit***>::type;
     BufferType<memblock> buff;
+    void *mapping = nullptr; // Região mapeada do cache (MemBlock), liberada com munmap em vez de delete[]
+    size_t mapping_size = 0;
+    bool owner = true;       // Falso para vistas sobre buffers externos, que não são liberados
+    void *slab = nullptr;    // Laje única de BufferPool que contém as tabelas e as linhas (Pointers)
 
     constexpr inline const pixel_unit& _obj(uint f, uint s, uint t) const { __I3D__obj_calc(f, s, t) }
     constexpr inline       pixel_unit& _obj(uint f, uint s, uint t)       { __I3D__obj_calc(f, s, t) }
     
+    void setDimensions(uint w, uint h, uint c);
     void init(uint w, uint h, uint c);
+    bool loadRaw(const std::string& path, int64_t src_size, int64_t src_mtime);
+    void saveRaw(const std::string& path, int64_t src_size, int64_t src_mtime) const;
 
    public:
     /**
-     * Cria um buffer de imagem não inicializado.
+     * Cria um buffer de imagem não inicializado, obtido de BufferPool.
      */
     Image3D(uint width, uint height, uint channels = 3);
 
     Image3D() : Image3D(0, 0, 0) {}
 
     /**
-     * Cria um buffer de uma imagem existente.
+     * Cria um buffer de uma imagem existente (ou a carrega de RawCache, se habilitado).
+     * Os valores inteiros são mantidos como no arquivo; em float, são divididos pelo máximo da profundidade do
+     * arquivo (255 ou, se algum valor o exceder, 65535).
      * forceDefaultChannels: Força o uso da quantidade padrão de channels.
      */
     Image3D(const char *file, bool forceDefaultChannels);
@@ -66,6 +171,24 @@ struct Image3D {
      */
     Image3D(const char *const file) : Image3D(file, false) { }
 
+    /**
+     * Vista (sem posse) sobre um buffer contíguo externo já na ordem de `order` (apenas MemBlock).
+     */
+    Image3D(pixel_unit *external, uint width, uint height, uint channels);
+
+    /**
+     * Cópia de uma imagem em outro layout; definido em ImageConvert.hpp (ver convert::image).
+     */
+    template<PixelOrder o2, bool m2>
+    explicit Image3D(const Image3D<o2, m2, T>& other);
+
+    /**
+     * Cópia profunda no mesmo layout (memcpy por bloco ou por linha).
+     */
+    Image3D(const Image3D& other);
+    Image3D(Image3D&& other);
+    Image3D& operator=(const Image3D&) = delete;
+
     ~Image3D();
 
 
@@ -75,6 +198,28 @@ struct Image3D {
     constexpr inline const auto& operator()(uint x, uint y, uint c) const { return at(x, y, c); }
 
 
+    /**
+     * Acesso direto ao buffer contíguo, na ordem de `order` com os passos firstPitch()/secondPitch()
+     * (apenas MemBlock; nullptr caso contrário).
+     */
+    pixel_unit* data() { if constexpr (memblock) return buff; else return nullptr; }
+    const pixel_unit* data() const { if constexpr (memblock) return buff; else return nullptr; }
+
+    size_t firstPitch() const { return _sf; }
+    size_t secondPitch() const { return _ss; }
+
+    /**
+     * Quantidade de elementos do buffer MemBlock, incluindo o preenchimento de linhas e de blocos.
+     */
+    size_t elements() const { return size_t(_dfw)*_sf; }
+
+    /**
+     * Verdadeiro se o buffer MemBlock não tem preenchimento (_dfw*_dsh*_dtc elementos seguidos).
+     */
+    bool isPacked() const { return _ss == _dtc && _sf == size_t(_dsh)*_dtc; }
+
+    bool isMapped() const { return mapping != nullptr; }
+
     uint getWidth() const { return width; }
     uint getHeight() const { return height; }
     uint getChannels() const { return channels; }
@@ -83,7 +228,11 @@ struct Image3D {
 
     void save(const char *const file) const;
 
+    /**
+     * Nome da implementação; tipos de pixel diferentes do padrão acrescentam o sufixo de PixelTraits (":u16", ":f32").
+     */
     static const std::string __implementation_type() {
-        return (memblock ? "MemBlock@" : "Pointers@") + _PixelOrder_getRepr(order);
+        const std::string type = std::is_same<T, default_pixel_unit>::value ? "" : std::string(":") + PixelTraits<T>::name;
+        return (memblock ? "MemBlock@" : "Pointers@") + _PixelOrder_getRepr(order) + type;
     }
 };
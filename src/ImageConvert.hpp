@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "Image3D.hpp"
+#include "SimdKernels.hpp"
+
+/**
+ * Conversão entre layouts de Image3D (qualquer PixelOrder, MemBlock ou Pointers) com o mesmo tipo de pixel,
+ * escolhendo o caminho mais rápido:
+ *  - mesmo layout, ambos MemBlock compactos: um único memcpy;
+ *  - mesma coordenada mais interna nos dois layouts: memcpy por sequência contígua;
+ *  - RGB intercalado (MemBlock) <-> planar ao longo da mesma coordenada, em 8 bits: (des)intercalação SIMD por sequência;
+ *  - demais casos (transposições e layouts em blocos): cópia em blocos de pixels, percorrendo o destino na sua
+ *    ordem de memória.
+ */
+namespace convert {
+
+enum Axis : unsigned { X = 0, Y = 1, C = 2 };
+
+/**
+ * Coordenadas da primeira, segunda e terceira (mais interna, contígua) dimensão de memória de um PixelOrder.
+ * Os layouts em blocos não têm dimensões lineares; para eles, é a ordem de percurso preferida (linhas, canais dentro).
+ */
+struct Axes { Axis first, second, third; };
+
+constexpr Axes axes(PixelOrder o) {
+    switch (o) {
+        default:
+        case PixelOrder::XYC: return {X, Y, C};
+        case PixelOrder::XCY: return {X, C, Y};
+        case PixelOrder::YXC: return {Y, X, C};
+        case PixelOrder::YCX: return {Y, C, X};
+        case PixelOrder::CXY: return {C, X, Y};
+        case PixelOrder::CYX: return {C, Y, X};
+        case PixelOrder::TILE8:
+        case PixelOrder::MORTON: return {Y, X, C};
+    }
+}
+
+/**
+ * Distância (em elementos) entre vizinhos em x, y e c de uma imagem MemBlock, incluindo o preenchimento de RowPitch.
+ */
+struct Strides { size_t x, y, c; };
+
+template<PixelOrder o, bool m, typename T>
+Strides strides(const Image3D<o, m, T>& img) {
+    const Axes a = axes(o);
+    size_t s[3] = {0, 0, 0};
+    s[a.third] = 1;
+    s[a.second] = img.secondPitch();
+    s[a.first] = img.firstPitch();
+    return {s[X], s[Y], s[C]};
+}
+
+/**
+ * Lado do bloco (em pixels) da cópia genérica: 64x64x3 bytes de origem e destino cabem juntos na L1.
+ */
+constexpr uint BLOCK = 64;
+
+template<PixelOrder o1, bool m1, PixelOrder o2, bool m2, typename P>
+void image(const Image3D<o1, m1, P>& src, Image3D<o2, m2, P>& dst) {
+    const uint ext[3] = {src.getWidth(), src.getHeight(), src.getChannels()};
+    assert(dst.getWidth() == ext[X] && dst.getHeight() == ext[Y] && dst.getChannels() == ext[C]);
+    if (size_t(ext[X])*ext[Y]*ext[C] == 0) return;
+
+    constexpr Axes a1 = axes(o1), a2 = axes(o2);
+    constexpr bool linear = !_PixelOrder_isBlocked(o1) && !_PixelOrder_isBlocked(o2);
+    uint p[3];
+    if constexpr (o1 == o2 && m1 && m2) {
+        if (src.isPacked() && dst.isPacked()) {
+            std::memcpy(dst.data(), src.data(), src.elements()*sizeof(P));
+            return;
+        }
+    }
+    if constexpr (linear && a1.third == a2.third) {
+        // A terceira dimensão é contígua também nos Pointers, então cada sequência é um memcpy
+        p[a2.third] = 0;
+        for (p[a2.first] = 0; p[a2.first] < ext[a2.first]; p[a2.first]++)
+            for (p[a2.second] = 0; p[a2.second] < ext[a2.second]; p[a2.second]++)
+                std::memcpy(&dst(p[X], p[Y], p[C]), &src(p[X], p[Y], p[C]), ext[a2.third]*sizeof(P));
+        return;
+    } else if constexpr (linear && m1 && a1.third == C && a1.second == a2.third && sizeof(P) == 1) {
+        // Origem intercalada ao longo de a1.second, destino com planos contíguos na mesma coordenada
+        if (ext[C] == 3) {
+            p[a1.second] = 0;
+            for (p[a1.first] = 0; p[a1.first] < ext[a1.first]; p[a1.first]++)
+                simd::deinterleave_rgb(&src(p[X], p[Y], 0), &dst(p[X], p[Y], 0), &dst(p[X], p[Y], 1), &dst(p[X], p[Y], 2), ext[a1.second]);
+            return;
+        }
+    } else if constexpr (linear && m2 && a2.third == C && a2.second == a1.third && sizeof(P) == 1) {
+        if (ext[C] == 3) {
+            p[a2.second] = 0;
+            for (p[a2.first] = 0; p[a2.first] < ext[a2.first]; p[a2.first]++)
+                simd::interleave_rgb(&src(p[X], p[Y], 0), &src(p[X], p[Y], 1), &src(p[X], p[Y], 2), &dst(p[X], p[Y], 0), ext[a2.second]);
+            return;
+        }
+    }
+
+    // Caso geral: blocos de BLOCKxBLOCK pixels (todos os canais), de forma que as leituras espalhadas da origem
+    // fiquem na cache enquanto o destino é escrito sequencialmente
+    size_t ss[3] = {0, 0, 0}; // Passos da origem (apenas MemBlock)
+    if constexpr (linear && m1 && m2) {
+        const Strides st = strides(src);
+        ss[X] = st.x;
+        ss[Y] = st.y;
+        ss[C] = st.c;
+    }
+    uint lo[3] = {0, 0, 0}, hi[3] = {0, 0, ext[C]};
+    for (lo[Y] = 0; lo[Y] < ext[Y]; lo[Y] += BLOCK) {
+        hi[Y] = std::min(lo[Y] + BLOCK, ext[Y]);
+        for (lo[X] = 0; lo[X] < ext[X]; lo[X] += BLOCK) {
+            hi[X] = std::min(lo[X] + BLOCK, ext[X]);
+            if constexpr (linear && m1 && m2) {
+                // Dois buffers contíguos: aritmética de ponteiros com passos fixos, sem recalcular índices por pixel
+                const size_t n = hi[a2.third] - lo[a2.third];
+                p[a2.third] = lo[a2.third];
+                p[a2.second] = lo[a2.second];
+                for (p[a2.first] = lo[a2.first]; p[a2.first] < hi[a2.first]; p[a2.first]++) {
+                    const P *s = &src(p[X], p[Y], p[C]);
+                    P *d = &dst(p[X], p[Y], p[C]);
+                    for (uint j = lo[a2.second]; j < hi[a2.second]; j++, s += ss[a2.second], d += dst.secondPitch())
+                        for (size_t k = 0; k < n; k++) d[k] = s[k*ss[a2.third]];
+                }
+            } else {
+                for (p[a2.first] = lo[a2.first]; p[a2.first] < hi[a2.first]; p[a2.first]++)
+                    for (p[a2.second] = lo[a2.second]; p[a2.second] < hi[a2.second]; p[a2.second]++)
+                        for (p[a2.third] = lo[a2.third]; p[a2.third] < hi[a2.third]; p[a2.third]++)
+                            dst(p[X], p[Y], p[C]) = src(p[X], p[Y], p[C]);
+            }
+        }
+    }
+}
+
+}  // namespace convert
+
+template<PixelOrder order, bool memblock, typename T>
+template<PixelOrder o2, bool m2>
+Image3D<order, memblock, T>::Image3D(const Image3D<o2, m2, T>& other) : Image3D(other.getWidth(), other.getHeight(), other.getChannels()) {
+    convert::image(other, *this);
+}
@@ -1,69 +1,317 @@
 #pragma once
 #include <iostream>
-#include <unordered_set>
+#include <cassert>
 #include <limits>
+#include <vector>
+#include <array>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <cmath>
 
 #include "Image3D.hpp"
+#include "ImageConvert.hpp"
 #include "benchmark.hpp"
+#include "PerfCounters.hpp"
+#include "SimdKernels.hpp"
+#include "TaskScheduler.hpp"
+#include "BoundedQueue.hpp"
+#include "StripIO.hpp"
+#include "BufferPool.hpp"
+#include "Traversal.hpp"
+#include "Numa.hpp"
+#include "Roofline.hpp"
+#include "Results.hpp"
 
-//
-// Aqui apenas criamos um atalho para dois ou três fors aninhados
-//
+/**
+ * Dimensões (em pixels) dos tiles usados pelo motor de execução dos estênceis.
+ */
+struct TileSize {
+    uint width, height;
+};
 
-#ifdef PARALLELIZE
-#include <omp.h>
-#define ONLY_IN_PARALLEL(x) x
-#else
-#define ONLY_IN_PARALLEL(x)
-#endif
+/**
+ * Retângulo [x0, x1) x [y0, y1) de uma imagem, em pixels.
+ */
+struct Rect {
+    uint x0, y0, x1, y1;
+};
 
-// Esse é um for-aninhado na qual as variáveis x e y são do tipo T.
-// Os limites de x é (0, xl) e de y é (0, yl)
-#define biforT_s(x, xl, y, yl, T)  \
-    for (T x = 0; x < xl; x++)     \
-        for (T y = 0; y < yl; y++)
+struct ImagingAlgorithmsBase : public ImagingBenchmark {
+    // Raio da janela do blur, compartilhado por todas as implementações
+    static inline uint blur_radius = 2;
 
-#define biforT(x, xl, y, yl, T)                               \
-    ONLY_IN_PARALLEL(_Pragma("omp parallel for collapse(2)")) \
-    biforT_s(x, xl, y, yl, T)
+    /**
+     * Natureza de um algoritmo para os motores de execução: pontual (cada pixel da saída depende apenas do mesmo
+     * pixel da origem), estêncil (lê uma vizinhança e precisa de halo nos tiles e nas faixas) ou redução (a saída
+     * depende da imagem inteira, como nos histogramas: não é dividida em tiles independentes).
+     */
+    enum class KernelKind { POINT, STENCIL, REDUCTION };
 
-// Esse é um for-aninhado-triplo na qual as variáveis x, y e z são do tipo T.
-// Os limites de x é (0, xl), de y é (0, yl) e de z é (0, zl)
-#define triforT(x, xl, y, yl, z, zl, T)                       \
-    ONLY_IN_PARALLEL(_Pragma("omp parallel for collapse(3)")) \
-    biforT_s(x, xl, y, yl, T)                                 \
-        for (T z = 0; z < zl; z++)
+    /**
+     * Paralelismo de um lote de imagens: dentro de cada imagem (tiles e faixas distribuídos entre as threads, uma
+     * imagem após a outra), entre imagens (uma imagem inteira por tarefa, sem regiões paralelas aninhadas) ou AUTO,
+     * que usa INTER quando todas as imagens têm até `batch_pixels` pixels.
+     */
+    enum class BatchPolicy { INTRA, INTER, AUTO };
+    static inline size_t batch_pixels = 512*512;
 
-// Esse é um for-aninhado de x e y, ambos inteiros, variando de 0 a {x|y}l
-#define bifor(x, xl, y, yl) biforT(x, xl, y, yl, int)
+    static const char *batchPolicyName(BatchPolicy p) {
+        return p == BatchPolicy::INTER ? "inter" : p == BatchPolicy::INTRA ? "intra" : "auto";
+    }
 
-// Esse é um for-aninhado-triplo de x, y e z, todos inteiros, variando de 0 a {x|y|z}l
-#define trifor(x, xl, y, yl, z, zl) triforT(x, xl, y, yl, z, zl, int)
+    virtual const std::vector<std::string> getAlgorithms() const = 0;
+    virtual bool isEnabled(const std::string& a) const = 0;
+    virtual void setEnabled(const std::string& a, bool isEnabled) = 0;
 
-// Esse é um for-aninhado das coordenadas x e y, ambos inteiros, de uma imagem
-#define biforImg(img, x_var, y_var) biforT(y_var, img.getHeight(), x_var, img.getWidth(), uint)
+    /**
+     * Cronometra separadamente cada algoritmo habilitado sobre a imagem `file`,
+     * com uma execução de aquecimento seguida de `opts.repetitions` execuções cronometradas.
+     */
+    virtual std::vector<BenchRecord> benchmark_algorithms(const char *file, const BenchOptions& opts) const = 0;
 
-// Esse é um for-aninhado-triplo das coordenadas x, y e c, todos inteiros, de uma imagem
-#define triforImg(img, x_var, y_var, c_var) triforT(y_var, img.getHeight(), x_var, img.getWidth(), c_var, i2d.getChannels(), uint)
+    /**
+     * Processa a lista de imagens em pipeline: `loaders` threads decodificam e convertem as próximas imagens
+     * para o layout desta implementação enquanto a thread atual executa os algoritmos habilitados sobre a
+     * imagem corrente. No máximo `depth` imagens prontas aguardam na fila. Com loaders = 0, carrega e
+     * processa em sequência na própria thread, como referência.
+     */
+    virtual std::vector<BenchRecord> benchmark_pipeline(const std::vector<std::string>& files, uint loaders, uint depth) const = 0;
 
+    /**
+     * Processa um PPM binário (P6) em faixas de `strip_rows` linhas, cada uma lida com o halo exigido pelos
+     * estênceis habilitados, de modo que a memória fique limitada a poucas faixas independentemente do tamanho
+     * da imagem. As reduções (histogramas) veem apenas a faixa corrente com seu halo, como uma equalização local.
+     * A saída do último algoritmo habilitado é escrita faixa a faixa em `output`, se não vazio.
+     * Reporta o tempo e o pico de memória residente (peak_rss_kb) da execução.
+     */
+    virtual std::vector<BenchRecord> benchmark_streaming(const char *file, uint strip_rows, const std::string& output) const = 0;
 
-struct ImagingAlgorithmsBase : public ImagingBenchmark {
-    virtual const std::vector<std::string> getAlgorithms() const = 0;
-    virtual bool isEnabled(const std::string& a) const = 0;
-    virtual void setEnabled(const std::string& a, bool isEnabled) = 0;
+    /**
+     * Carrega todas as imagens de `files` e cronometra os algoritmos habilitados sobre o lote inteiro com as
+     * estratégias INTRA e INTER (uma execução de aquecimento e opts.repetitions cronometradas cada), reportando
+     * imagens por segundo e qual delas AUTO escolheria.
+     */
+    virtual std::vector<BenchRecord> benchmark_batch(const std::vector<std::string>& files, const BenchOptions& opts) const = 0;
+
+    /**
+     * Tipo de pixel das imagens desta implementação (PixelTraits::name: "u8", "u16" ou "f32").
+     */
+    virtual const std::string pixelType() const = 0;
+
+    virtual TileSize getTileSize() const = 0;
+    virtual void setTileSize(TileSize t) = 0;
+
+    /**
+     * Escolhe o tamanho de tile mais rápido para esta implementação, medido com sobel sobre a imagem `file`.
+     */
+    virtual TileSize autotuneTileSize(const char *file) = 0;
 };
 
 template<typename ImageType>
 struct ImagingAlgorithms : public ImagingAlgorithmsBase {
+    typedef void (*AlgorithmFn)(const ImageType&, ImageType&);
+    typedef void (*RectFn)(const ImageType&, ImageType&, uint, uint, uint, uint);
+
+    /**
+     * Despacha um algoritmo ponto-a-ponto de escala de cinza para os núcleos vetorizados de SimdKernels,
+     * quando o layout permite: MemBlock planar (CXY/CYX) ou intercalado RGB (XYC/YXC, TILE8, MORTON) de 8 bits.
+     * Buffers compactos são percorridos como uma única sequência; com preenchimento, linha a linha.
+     * Retorna false quando o chamador deve usar a versão genérica.
+     */
+    static bool simd_grayscale(simd::GrayOp op, const ImageType &i2d, ImageType &dst) {
+        using pu = typename ImageType::pixel_unit;
+        constexpr PixelOrder o = ImageType::pixel_order;
+        if constexpr (ImageType::is_memblock && std::is_same<pu, uint8_t>::value) {
+            const size_t n = size_t(i2d.getWidth())*i2d.getHeight();
+            constexpr size_t chunk = 1 << 16; // Unidade de trabalho de cada thread na build paralela
+            const long chunks = (n + chunk - 1)/chunk;
+            constexpr bool planar = o == PixelOrder::CXY || o == PixelOrder::CYX;
+            if constexpr (planar || o == PixelOrder::XYC || o == PixelOrder::YXC) {
+                if (planar ? i2d.getChannels() < 3 : i2d.getChannels() != 3) return false;
+                if (!i2d.isPacked() || !dst.isPacked()) {
+                    // Com preenchimento (RowPitch) o buffer não é uma sequência única: vetoriza linha a linha
+                    tiled(i2d, 0, [&](uint x0, uint y0, uint x1, uint y1) { gray_rect(op, i2d, dst, x0, y0, x1, y1); }, no_border);
+                    return true;
+                }
+            }
+            if constexpr (_PixelOrder_isBlocked(o)) {
+                // Blocos com canais intercalados e sem preenchimento de linhas: o buffer todo é RGB intercalado
+                // (os pixels de preenchimento dos blocos também são processados, sem efeito visível)
+                if (i2d.getChannels() != 3) return false;
+                const size_t m = i2d.elements()/3, bchunks = (m + chunk - 1)/chunk;
+                const pu *s = i2d.data();
+                pu *d = dst.data();
+                parallel::for_range(bchunks, [&](long k) {
+                    const size_t i = k*chunk;
+                    simd::gray_interleaved_rgb(op, s + 3*i, d + 3*i, std::min(chunk, m - i));
+                });
+                return true;
+            } else if constexpr (planar) {
+                const pu *s = i2d.data();
+                pu *d = dst.data();
+                parallel::for_range(chunks, [&](long k) {
+                    const size_t i = k*chunk, m = std::min(chunk, n - i);
+                    simd::gray_planar(op, s + RED*n + i, s + GREEN*n + i, s + BLUE*n + i, d + RED*n + i, d + GREEN*n + i, d + BLUE*n + i, m);
+                });
+                return true;
+            } else if constexpr (o == PixelOrder::XYC || o == PixelOrder::YXC) {
+                const pu *s = i2d.data();
+                pu *d = dst.data();
+                parallel::for_range(chunks, [&](long k) {
+                    const size_t i = k*chunk, m = std::min(chunk, n - i);
+                    simd::gray_interleaved_rgb(op, s + 3*i, d + 3*i, m);
+                });
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Tamanho de tile padrão: tiles alongados na coordenada (x ou y) que varia mais rápido na memória,
+     * ou quadrados nos layouts em blocos, cujos vizinhos nas duas direções estão próximos.
+     */
+    static constexpr TileSize default_tile_size() {
+        constexpr PixelOrder o = ImageType::pixel_order;
+        if (_PixelOrder_isBlocked(o)) return TileSize{64, 64};
+        return (o == PixelOrder::XYC || o == PixelOrder::XCY || o == PixelOrder::CXY) ? TileSize{32, 256} : TileSize{256, 32};
+    }
+    static inline TileSize tile_size = default_tile_size();
+
+    /**
+     * Retângulo r expandido de `halo` pixels em cada direção e limitado à imagem.
+     */
+    static Rect expand(const ImageType &img, const Rect &r, uint halo) {
+        const uint w = img.getWidth(), h = img.getHeight();
+        return {r.x0 > halo ? r.x0 - halo : 0, r.y0 > halo ? r.y0 - halo : 0,
+                std::min(w, std::min(r.x1, w) + halo), std::min(h, std::min(r.y1, h) + halo)};
+    }
+
+    /**
+     * Divide r em tiles de tile_size e executa fn(x0, y0, x1, y1) sobre cada um em paralelo.
+     */
+    template<typename Fn>
+    static void tiled_rect(const Rect &r, Fn fn) {
+        if (r.x0 >= r.x1 || r.y0 >= r.y1) return;
+        const uint tw = tile_size.width, th = tile_size.height;
+        const long tx = (r.x1 - r.x0 + tw - 1)/tw, ty = (r.y1 - r.y0 + th - 1)/th;
+        parallel::for_range(tx*ty, [&](long t) {
+            const uint x0 = r.x0 + (t % tx)*tw, y0 = r.y0 + (t / tx)*th;
+            fn(x0, y0, std::min(x0 + tw, r.x1), std::min(y0 + th, r.y1));
+        });
+    }
+
+    /**
+     * Motor de execução em tiles para estênceis de raio `halo`.
+     * interior(x0, y0, x1, y1) é chamado para cada tile de [halo, w-halo) x [halo, h-halo), região na qual todos os
+     * vizinhos até a distância `halo` existem, de modo que o caminho interno não precisa testar os limites da imagem.
+     * border(x0, y0, x1, y1) é chamado para as quatro faixas restantes (ou para a imagem toda, se não houver interior).
+     */
+    template<typename Interior, typename Border>
+    static void tiled(const ImageType &img, uint halo, Interior interior, Border border) {
+        const uint w = img.getWidth(), h = img.getHeight();
+        if (w <= 2*halo || h <= 2*halo) {
+            border(0, 0, w, h);
+            return;
+        }
+        const uint tw = tile_size.width, th = tile_size.height;
+        const long tx = (w - 2*halo + tw - 1)/tw, ty = (h - 2*halo + th - 1)/th;
+        parallel::for_range(tx*ty, [&](long t) {
+            const uint x0 = halo + (t % tx)*tw, y0 = halo + (t / tx)*th;
+            interior(x0, y0, std::min(x0 + tw, w - halo), std::min(y0 + th, h - halo));
+        });
+        if (halo == 0) return;
+        border(0, 0, w, halo);
+        border(0, h - halo, w, h);
+        border(0, halo, halo, h - halo);
+        border(w - halo, halo, w, h - halo);
+    }
+
+    static void no_border(uint, uint, uint, uint) {}
+
+    typedef Traversal<ImageType> Trav;
+
+    /**
+     * Aplica fn(x, y) a todos os pixels, distribuindo entre as threads faixas da coordenada espacial externa do
+     * layout (colunas em XYC, XCY e CXY; linhas nos demais), percorridas na ordem de memória.
+     */
+    template<typename Fn>
+    static void for_each_pixel(const ImageType &img, Fn fn) {
+        constexpr uint strip = 16;
+        const uint w = img.getWidth(), h = img.getHeight();
+        const bool by_x = Trav::x_outer && Trav::layout_order();
+        const uint n = by_x ? w : h;
+        parallel::for_range((n + strip - 1)/strip, [&](long s) {
+            const uint a = s*strip, b = std::min(n, a + strip);
+            if (by_x) Trav::pixels(a, 0, b, h, fn);
+            else Trav::pixels(0, a, w, b, fn);
+        });
+    }
+
+    /**
+     * Aplica o algoritmo ponto-a-ponto `op` ao retângulo [x0, x1) x [y0, y1). Vetorizado quando o layout é
+     * MemBlock de 8 bits e as linhas (YXC, CYX) ou as colunas (XYC, CXY) do retângulo são contíguas na memória.
+     */
+    static void gray_rect(simd::GrayOp op, const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        using pu = typename ImageType::pixel_unit;
+        constexpr PixelOrder o = ImageType::pixel_order;
+        if constexpr (ImageType::is_memblock && std::is_same<pu, uint8_t>::value) {
+            constexpr bool planar = o == PixelOrder::CXY || o == PixelOrder::CYX;
+            constexpr bool interleaved = o == PixelOrder::XYC || o == PixelOrder::YXC;
+            constexpr bool along_x = o == PixelOrder::CYX || o == PixelOrder::YXC;
+            if ((planar && i2d.getChannels() >= 3) || (interleaved && i2d.getChannels() == 3)) {
+                const uint k0 = along_x ? y0 : x0, k1 = along_x ? y1 : x1, len = along_x ? x1 - x0 : y1 - y0;
+                if (len == 0) return;
+                for (uint k = k0; k < k1; k++) {
+                    const uint x = along_x ? x0 : k, y = along_x ? k : y0;
+                    if constexpr (planar) {
+                        simd::gray_planar(op, &i2d(x, y, RED), &i2d(x, y, GREEN), &i2d(x, y, BLUE),
+                                          &dst(x, y, RED), &dst(x, y, GREEN), &dst(x, y, BLUE), len);
+                    } else {
+                        simd::gray_interleaved_rgb(op, &i2d(x, y, RED), &dst(x, y, RED), len);
+                    }
+                }
+                return;
+            }
+        }
+        Trav::pixels(x0, y0, x1, y1, [&](uint x, uint y) {
+            dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = gray_value(op, i2d(x, y, RED), i2d(x, y, GREEN), i2d(x, y, BLUE));
+        });
+    }
+
+    /**
+     * Versão escalar de um pixel para qualquer tipo: inteiros usam simd::gray_scalar; float, as mesmas fórmulas
+     * sem truncamento.
+     */
+    static typename ImageType::pixel_unit gray_value(simd::GrayOp op, typename ImageType::pixel_unit r,
+                                                     typename ImageType::pixel_unit g, typename ImageType::pixel_unit b) {
+        using pu = typename ImageType::pixel_unit;
+        if constexpr (std::is_integral<pu>::value) {
+            return pu(simd::gray_scalar(op, r, g, b));
+        } else {
+            switch (op) {
+                default:
+                case simd::GrayOp::AVERAGING: return (r + g + b)/3;
+                case simd::GrayOp::LUMA: return (r*30 + g*59 + b*11)/100;
+                case simd::GrayOp::DESATURATION: return (std::max(std::max(r, g), b) + std::min(std::min(r, g), b))/2;
+                case simd::GrayOp::DE_COMPOSITION_MAX: return std::max(std::max(r, g), b);
+                case simd::GrayOp::DE_COMPOSITION_MIN: return std::min(std::min(r, g), b);
+            }
+        }
+    }
+
     /**
      * Método Averaging
      * Método #1 de https://www.tannerhelland.com/3643/grayscale-image-algorithm-vb6/
      */
     static void averaging(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            unsigned int avg = (i2d(x, y, RED) + i2d(x, y, GREEN) + i2d(x, y, BLUE)) / 3;
+        if (simd_grayscale(simd::GrayOp::AVERAGING, i2d, dst)) return;
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            const typename ImageType::pixel_unit avg = (i2d(x, y, RED) + i2d(x, y, GREEN) + i2d(x, y, BLUE)) / 3;
             dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = avg;
-        }
+        });
 
     }
 
@@ -73,85 +321,316 @@ struct ImagingAlgorithms : public ImagingAlgorithmsBase {
      * Método #2 de https://www.tannerhelland.com/3643/grayscale-image-algorithm-vb6/
      */
     static void luma(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            unsigned int avg = (i2d(x, y, RED)*30 + i2d(x, y, GREEN)*59 + i2d(x, y, BLUE)*11) / 100;
+        if (simd_grayscale(simd::GrayOp::LUMA, i2d, dst)) return;
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            const typename ImageType::pixel_unit avg = (i2d(x, y, RED)*30 + i2d(x, y, GREEN)*59 + i2d(x, y, BLUE)*11) / 100;
             dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = avg;
-        }
+        });
+
+    }
 
+    typedef typename PixelTraits<typename ImageType::pixel_unit>::grad Grad;
+
+    /**
+     * Gradientes horizontal e vertical de Sobel em (x, y, c). Não testa os limites da imagem.
+     */
+    static inline void sobel_gradients(const ImageType &i2d, uint x, uint y, uint c, Grad &hor, Grad &ver) {
+        hor = Grad(i2d(x-1, y-1, c) + 2*Grad(i2d(x, y-1, c)) + i2d(x+1, y-1, c)) - Grad(i2d(x-1, y+1, c) + 2*Grad(i2d(x, y+1, c)) + i2d(x+1, y+1, c));
+        ver = Grad(i2d(x-1, y-1, c) + 2*Grad(i2d(x-1, y, c)) + i2d(x-1, y+1, c)) - Grad(i2d(x+1, y-1, c) + 2*Grad(i2d(x+1, y, c)) + i2d(x+1, y+1, c));
+    }
+
+    /**
+     * Mesmos gradientes a partir do ponteiro p = &i2d(x, y, c) e dos passos sx e sy do buffer (layouts strided).
+     */
+    static inline void sobel_gradients(const typename ImageType::pixel_unit *p, ptrdiff_t sx, ptrdiff_t sy, Grad &hor, Grad &ver) {
+        hor = Grad(p[-sx-sy] + 2*Grad(p[-sy]) + p[sx-sy]) - Grad(p[-sx+sy] + 2*Grad(p[sy]) + p[sx+sy]);
+        ver = Grad(p[-sx-sy] + 2*Grad(p[-sx]) + p[-sx+sy]) - Grad(p[sx-sy] + 2*Grad(p[sx]) + p[sx+sy]);
+    }
+
+    /**
+     * G = white*sqrt(g²)/maxdiv, limitado a white (PixelTraits), com g² = hor² + ver².
+     */
+    static double sobel_magnitude(double g2) {
+        const double white = PixelTraits<typename ImageType::pixel_unit>::white;
+        const double maxdiv = std::sqrt((4*white)*(4*white) + (2*white)*(2*white));
+        // This comes from the following matrix: [[255 255 255] [255 0 0] [0 0 0]] which maximizes the Sobel filter
+        return std::min(white, white*(std::sqrt(g2)/maxdiv));
+    }
+
+    /**
+     * Aplica g(hor, ver) -> pixel a cada elemento de [x0, x1) x [y0, y1) x [0, canais), na ordem de memória. Nos
+     * layouts strided, cada sequência contígua é percorrida com ponteiros incrementais na origem e no destino.
+     */
+    template<typename G>
+    static void sobel_walk(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1, G g) {
+        if constexpr (Trav::strided) {
+            if (Trav::layout_order()) {
+                const auto st = convert::strides(i2d);
+                const ptrdiff_t sx = st.x, sy = st.y;
+                Trav::runs(i2d, x0, y0, x1, y1, i2d.getChannels(), [&](uint x, uint y, uint c, uint n) {
+                    const auto *s = &i2d(x, y, c);
+                    auto *d = &dst(x, y, c);
+                    for (uint k = 0; k < n; k++) {
+                        Grad hor, ver;
+                        sobel_gradients(s + k, sx, sy, hor, ver);
+                        d[k] = g(hor, ver);
+                    }
+                });
+                return;
+            }
+        }
+        Trav::elements(x0, y0, x1, y1, i2d.getChannels(), [&](uint x, uint y, uint c) {
+            Grad hor, ver;
+            sobel_gradients(i2d, x, y, c, hor, ver);
+            dst(x, y, c) = g(hor, ver);
+        });
     }
 
     /**
      * Método de detecção de bordas Sobel
      * Formulação da função G=SQRT(G_x^2 + G_y^2): https://en.wikipedia.org/wiki/Sobel_operator
+     * As bordas da imagem não são escritas.
      */
     static void sobel(const ImageType &i2d, ImageType &dst) {
-        const auto pvmax = std::numeric_limits<typename ImageType::pixel_unit>::max();
-        const auto maxdiv_p0 = 4*pvmax, maxdiv_p1 = 2*pvmax;
-        const auto maxdiv = std::sqrt(maxdiv_p0*maxdiv_p0 + maxdiv_p1*maxdiv_p1);
-        // This comes from the following matrix: [[255 255 255] [255 0 0] [0 0 0]] which maximizes the Sobel filter
+        tiled(i2d, 1, [&](uint x0, uint y0, uint x1, uint y1) { sobel_rect(i2d, dst, x0, y0, x1, y1); }, no_border);
+    }
 
-        triforImg(i2d, x, y, c) {
-            if (x == 0 || y == 0 || x == i2d.getWidth()-1 || y == i2d.getHeight()-1) continue;
-            int hor = int(i2d(x-1, y-1, c) + 2*int(i2d(x, y-1, c)) + i2d(x+1, y-1, c)) - int(i2d(x-1, y+1, c) + 2*int(i2d(x, y+1, c)) + i2d(x+1, y+1, c));
-            int ver = int(i2d(x-1, y-1, c) + 2*int(i2d(x-1, y, c)) + i2d(x-1, y+1, c)) - int(i2d(x+1, y-1, c) + 2*int(i2d(x+1, y, c)) + i2d(x+1, y+1, c));
-            dst(x, y, c) = pvmax*(std::sqrt(hor*hor + ver*ver)/maxdiv);
-        }
+    /**
+     * Retângulo [x0, x1) x [y0, y1) de sobel, recortado para excluir as bordas da imagem.
+     */
+    static void sobel_rect(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        x0 = std::max(x0, 1u); y0 = std::max(y0, 1u);
+        x1 = std::min(x1, i2d.getWidth() - 1); y1 = std::min(y1, i2d.getHeight() - 1);
+        if (x0 >= x1 || y0 >= y1) return;
+        sobel_walk(i2d, dst, x0, y0, x1, y1, [&](Grad hor, Grad ver) {
+            return typename ImageType::pixel_unit(sobel_magnitude(double(hor)*hor + double(ver)*ver));
+        });
     }
 
     /**
      * Método de detecção de bordas Sobel
      * Formulação da função G=SQRT(G_x^2 + G_y^2): https://en.wikipedia.org/wiki/Sobel_operator
      * Tentei substituir a raiz quadrada por uma busca binária. Não deu muito certo :/
+     * Em float não há valores discretos para a busca: equivale a sobel.
      */
     static void sobel_v2(const ImageType &i2d, ImageType &dst) {
+        const auto bsrch = sobel_v2_table();
+        tiled(i2d, 1, [&](uint x0, uint y0, uint x1, uint y1) { sobel_v2_rect(i2d, dst, bsrch, x0, y0, x1, y1); }, no_border);
+    }
+
+    typedef std::vector<int64_t> SobelV2Table;
+
+    /**
+     * Tabela da busca binária de sobel_v2: bsrch[i] é o menor G² que resulta em um valor maior que i
+     * (white entradas; vazia em float).
+     */
+    static SobelV2Table sobel_v2_table() {
         using pu = typename ImageType::pixel_unit;
-        const auto pvmax = std::numeric_limits<pu>::max();
-        const auto maxdiv_p0 = 4*pvmax, maxdiv_p1 = 2*pvmax;
-        const auto maxdiv = std::sqrt(maxdiv_p0*maxdiv_p0 + maxdiv_p1*maxdiv_p1);
-        // This comes from the following matrix: [[255 255 255] [255 0 0] [0 0 0]] which maximizes the Sobel filter
-        assert(pvmax == 255);
-        int bsrch[pvmax];
-        for (pu i = 0; i < pvmax; i++) {
-            const auto i_ = double((i+1)*maxdiv)/double(pvmax);
-            bsrch[i] = int(i_*i_);
-        }
-
-        triforImg(i2d, x, y, c) {
-            if (x == 0 || y == 0 || x == i2d.getWidth()-1 || y == i2d.getHeight()-1) continue;
-            const int hor = int(i2d(x-1, y-1, c) + 2*int(i2d(x, y-1, c)) + i2d(x+1, y-1, c)) - int(i2d(x-1, y+1, c) + 2*int(i2d(x, y+1, c)) + i2d(x+1, y+1, c));
-            const int ver = int(i2d(x-1, y-1, c) + 2*int(i2d(x-1, y, c)) + i2d(x-1, y+1, c)) - int(i2d(x+1, y-1, c) + 2*int(i2d(x+1, y, c)) + i2d(x+1, y+1, c));
-            
-            const int g2 = hor*hor + ver*ver;
-            pu a = 0, z = pvmax, curr;
-            while (a != z) {
-                curr = (a+z)/2;
-                if (g2 < bsrch[curr]) z = curr;
-                else a = curr+1;
-            }
-            dst(x, y, c) = a;
-            #ifdef ONDEBUG
-            if (std::abs(int(pu(pvmax*(std::sqrt(g2)/maxdiv))) - int(a)) >= 2) {
-                std::cerr << "sobel and sobel_v2 equivalence test failed: g2=" << g2 << "\nmaxdiv=" << maxdiv << "\npvmax=" << int(pvmax)
-                          << "\ng2'=" << pvmax*(std::sqrt(g2)/maxdiv) << "\npu(g2')=" << int(pu(pvmax*(std::sqrt(g2)/maxdiv))) << "\na="
-                          << int(a) << "\nbrsch[:]= {";
-                for (int _ai = std::max(0, a-3); _ai < std::min(int(pvmax), a+3); _ai++) {
-                    const double i_ = double((_ai+1)*maxdiv)/double(pvmax), i2 = i_*i_;
-                    std::cerr << "  " << _ai << ": " << bsrch[_ai] << " << " << i_ << "²=" << std::to_string(i2) << "=" << int(i_*i_) << ",\n";
-                }
-                std::cerr << "}\n" << std::endl;
+        SobelV2Table bsrch;
+        if constexpr (std::is_integral<pu>::value) {
+            const double pvmax = PixelTraits<pu>::white;
+            const auto maxdiv = std::sqrt((4*pvmax)*(4*pvmax) + (2*pvmax)*(2*pvmax));
+            // This comes from the following matrix: [[255 255 255] [255 0 0] [0 0 0]] which maximizes the Sobel filter
+            bsrch.resize(PixelTraits<pu>::white);
+            for (size_t i = 0; i < bsrch.size(); i++) {
+                const auto i_ = double((i+1)*maxdiv)/pvmax;
+                bsrch[i] = int64_t(i_*i_);
             }
-            #endif
-            assert(std::abs(int(pu(pvmax*(std::sqrt(g2)/maxdiv))) - int(a)) < 2 && "This assertion should occour only after previous if");
+        }
+        return bsrch;
+    }
+
+    /**
+     * Retângulo [x0, x1) x [y0, y1) de sobel_v2, recortado para excluir as bordas da imagem.
+     */
+    static void sobel_v2_rect(const ImageType &i2d, ImageType &dst, const SobelV2Table &bsrch, uint x0, uint y0, uint x1, uint y1) {
+        using pu = typename ImageType::pixel_unit;
+        if constexpr (!std::is_integral<pu>::value) {
+            sobel_rect(i2d, dst, x0, y0, x1, y1);
+        } else {
+            const pu pvmax = PixelTraits<pu>::white;
+            x0 = std::max(x0, 1u); y0 = std::max(y0, 1u);
+            x1 = std::min(x1, i2d.getWidth() - 1); y1 = std::min(y1, i2d.getHeight() - 1);
+            if (x0 >= x1 || y0 >= y1) return;
+            sobel_walk(i2d, dst, x0, y0, x1, y1, [&](Grad hor, Grad ver) {
+                const int64_t g2 = int64_t(hor)*hor + int64_t(ver)*ver;
+                pu a = 0, z = pvmax, curr;
+                while (a != z) {
+                    curr = (a+z)/2;
+                    if (g2 < bsrch[curr]) z = curr;
+                    else a = curr+1;
+                }
+                #ifdef ONDEBUG
+                if (std::abs(int(sobel_magnitude(g2)) - int(a)) >= 2) {
+                    std::cerr << "sobel and sobel_v2 equivalence test failed: g2=" << g2 << "\npvmax=" << int(pvmax)
+                              << "\ng2'=" << sobel_magnitude(g2) << "\na=" << int(a) << "\nbrsch[:]= {";
+                    for (int _ai = std::max(0, a-3); _ai < std::min(int(pvmax), a+3); _ai++) {
+                        std::cerr << "  " << _ai << ": " << bsrch[_ai] << ",\n";
+                    }
+                    std::cerr << "}\n" << std::endl;
+                }
+                #endif
+                assert(std::abs(int(sobel_magnitude(g2)) - int(a)) < 2 && "This assertion should occour only after previous if");
+                return a;
+            });
         }
     }
 
 
     /**
-     * Método Blur colorido
+     * Sobel em ponto fixo: gradientes em inteiros de 16 bits, vetorizados sobre sequências inteiras nos layouts
+     * MemBlock de 8 bits, e G lido de simd::sobel_lut() pelo g² quantizado, sem raiz nem desvios.
+     * Difere de sobel em no máximo ±1 (saturando em 255). A tabela existe apenas para 8 bits: nos demais tipos
+     * de pixel, calcula G como sobel. As bordas da imagem não são escritas.
+     */
+    static void sobel_fixed(const ImageType &i2d, ImageType &dst) {
+        tiled(i2d, 1, [&](uint x0, uint y0, uint x1, uint y1) { sobel_fixed_rect(i2d, dst, x0, y0, x1, y1); }, no_border);
+        #ifdef ONDEBUG
+        if (i2d.getWidth() > 2 && i2d.getHeight() > 2)
+            Trav::elements(1, 1, i2d.getWidth() - 1, i2d.getHeight() - 1, i2d.getChannels(), [&](uint x, uint y, uint c) {
+                Grad hor, ver;
+                sobel_gradients(i2d, x, y, c, hor, ver);
+                const double ref = sobel_magnitude(double(hor)*hor + double(ver)*ver);
+                if (std::abs(int(ref) - int(dst(x, y, c))) >= 2)
+                    std::cerr << "sobel and sobel_fixed equivalence test failed at (" << x << ", " << y << ", " << c << ")\n";
+            });
+        #endif
+    }
+
+    /**
+     * Retângulo [x0, x1) x [y0, y1) de sobel_fixed, recortado para excluir as bordas da imagem.
+     */
+    static void sobel_fixed_rect(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        using pu = typename ImageType::pixel_unit;
+        if constexpr (!std::is_same<pu, uint8_t>::value) {
+            sobel_rect(i2d, dst, x0, y0, x1, y1);
+        } else {
+            x0 = std::max(x0, 1u); y0 = std::max(y0, 1u);
+            x1 = std::min(x1, i2d.getWidth() - 1); y1 = std::min(y1, i2d.getHeight() - 1);
+            if (x0 >= x1 || y0 >= y1) return;
+            if constexpr (Trav::strided) {
+                if (Trav::layout_order()) {
+                    const auto st = convert::strides(i2d);
+                    Trav::runs(i2d, x0, y0, x1, y1, i2d.getChannels(), [&](uint x, uint y, uint c, uint n) {
+                        simd::sobel_run(&i2d(x, y, c), st.x, st.y, &dst(x, y, c), n);
+                    });
+                    return;
+                }
+            }
+            const uint8_t *lut = simd::sobel_lut();
+            sobel_walk(i2d, dst, x0, y0, x1, y1, [&](int hor, int ver) { return pu(lut[(hor*hor + ver*ver) >> simd::SOBEL_LUT_SHIFT]); });
+        }
+    }
+
+    /**
+     * Método Blur colorido (média da janela (2r+1)x(2r+1), truncada nas bordas da imagem).
+     * Implementado como filtro separável de somas deslizantes, executado em tiles: uma passada horizontal
+     * por linha do tile (mais o halo vertical), guardada em um anel de 2r+1 linhas, e uma soma vertical por
+     * coluna. O custo por pixel independe do raio. Para r = 2 o resultado é idêntico ao de blur_5x5.
      */
     static void blur(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            uint pix[] = {0, 0, 0}, cc = 0;
+        const uint r = ImagingAlgorithmsBase::blur_radius;
+        const uint channels = std::min(3u, i2d.getChannels());
+        const auto rect = [&](uint x0, uint y0, uint x1, uint y1) {
+            for (uint c = 0; c < channels; c++) box_blur_rect(i2d, dst, r, c, x0, y0, x1, y1);
+        };
+        tiled(i2d, r, rect, rect);
+        #ifdef ONDEBUG
+        if (r == 2) {
+            ImageType ref(i2d.getWidth(), i2d.getHeight(), i2d.getChannels());
+            blur_5x5(i2d, ref);
+            Trav::elements(0, 0, i2d.getWidth(), i2d.getHeight(), channels, [&](uint x, uint y, uint c) {
+                // Em float, as somas deslizantes diferem da soma direta apenas por arredondamento
+                if (std::abs(double(ref(x, y, c)) - double(dst(x, y, c))) > (std::is_integral<typename ImageType::pixel_unit>::value ? 0 : 1e-5)) std::cerr << "blur and blur_5x5 equivalence test failed at (" << x << ", " << y << ", " << c << ")\n";
+            });
+        }
+        #endif
+    }
+
+    /**
+     * Retângulo [x0, x1) x [y0, y1) do canal c de blur. Nos layouts em que x é a coordenada externa, as somas
+     * deslizantes percorrem colunas em vez de linhas, seguindo a memória; a soma da janela é a mesma.
+     */
+    static void box_blur_rect(const ImageType &i2d, ImageType &dst, uint r, uint c, uint x0, uint y0, uint x1, uint y1) {
+        typedef typename ImageType::pixel_unit pu;
+        typedef typename PixelTraits<pu>::sum S;
+        if constexpr (Trav::x_outer) {
+            if (Trav::layout_order()) {
+                box_blur_lines(r, i2d.getHeight(), i2d.getWidth(), y0, x0, y1, x1,
+                               [&](int u, int v) { return S(i2d(v, u, c)); }, [&](int u, int v, S val) { dst(v, u, c) = pu(val); });
+                return;
+            }
+        }
+        box_blur_lines(r, i2d.getWidth(), i2d.getHeight(), x0, y0, x1, y1,
+                       [&](int u, int v) { return S(i2d(u, v, c)); }, [&](int u, int v, S val) { dst(u, v, c) = pu(val); });
+    }
+
+    /**
+     * Blur de [x0, x1) x [y0, y1) em uma grade de w_ x h_ (a imagem ou sua transposta), lida com get(x, y) e escrita
+     * com put(x, y, soma/área): somas deslizantes por linha (no tipo PixelTraits::sum, exato para os inteiros)
+     * guardadas em um anel de 2r+1 linhas. Os trechos em que a janela é recortada pelas bordas da imagem têm laços
+     * próprios; dentro de tiles interiores esses trechos são vazios.
+     */
+    template<typename Get, typename Put>
+    static void box_blur_lines(uint r, uint w_, uint h_, uint x0, uint y0, uint x1, uint y1, Get get, Put put) {
+        typedef typename PixelTraits<typename ImageType::pixel_unit>::sum S;
+        const int w = w_, h = h_, ri = r, win = 2*r + 1, tw = x1 - x0;
+        thread_local std::vector<S> ring, colsum;
+        thread_local std::vector<uint32_t> cx;
+        ring.resize(size_t(win)*tw);
+        colsum.assign(tw, 0);
+        cx.resize(tw);
+        for (int x = x0; x < int(x1); x++) cx[x - x0] = std::min(x + ri, w - 1) - std::max(x - ri, 0) + 1;
+        // [xa, xb): colunas nas quais a janela desliza sem tocar as bordas
+        const int xa = std::min(std::max(ri, int(x0)), int(x1)), xb = std::max(xa, std::min(w - ri - 1, int(x1)));
+
+        // Soma horizontal da linha y, guardada no slot correspondente do anel e acumulada em colsum
+        const auto add_row = [&](int y) {
+            S *row = &ring[size_t(y % win)*tw], sum = 0;
+            for (int x = std::max(int(x0) - ri, 0); x <= std::min(int(x0) + ri, w - 1); x++) sum += get(x, y);
+            int x = x0;
+            for (; x < xa; x++) {
+                row[x - x0] = sum;
+                if (x + ri + 1 < w) sum += get(x + ri + 1, y);
+                if (x - ri >= 0) sum -= get(x - ri, y);
+            }
+            for (; x < xb; x++) {
+                row[x - x0] = sum;
+                sum += get(x + ri + 1, y);
+                sum -= get(x - ri, y);
+            }
+            for (; x < int(x1); x++) {
+                row[x - x0] = sum;
+                if (x + ri + 1 < w) sum += get(x + ri + 1, y);
+                if (x - ri >= 0) sum -= get(x - ri, y);
+            }
+            for (x = 0; x < tw; x++) colsum[x] += row[x];
+        };
+        const auto remove_row = [&](int y) {
+            const S *row = &ring[size_t(y % win)*tw];
+            for (int x = 0; x < tw; x++) colsum[x] -= row[x];
+        };
+
+        const int first = std::max(int(y0) - ri, 0); // Primeira linha acumulada neste retângulo
+        for (int y = first; y < std::min(int(y0) + ri, h); y++) add_row(y);
+        for (int y = y0; y < int(y1); y++) {
+            if (y - ri - 1 >= first) remove_row(y - ri - 1);
+            if (y + ri < h) add_row(y + ri);
+            const uint32_t cy = std::min(y + ri, h - 1) - std::max(y - ri, 0) + 1;
+            for (int x = 0; x < tw; x++) {
+                put(x0 + x, y, colsum[x]/(cx[x]*cy));
+            }
+        }
+    }
+
+    /**
+     * Método Blur colorido original, com a janela 5x5 recalculada para cada pixel.
+     * Mantido como referência para blur.
+     */
+    static void blur_5x5(const ImageType &i2d, ImageType &dst) {
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            typename PixelTraits<typename ImageType::pixel_unit>::sum pix[] = {0, 0, 0};
+            uint cc = 0;
             for (int dy = -2; dy <= 2; dy++) {
                 if (y + dy < 0 || y + dy >= i2d.getHeight()) continue;
                 for (int dx = -2; dx <= 2; dx++) {
@@ -163,37 +642,268 @@ struct ImagingAlgorithms : public ImagingAlgorithmsBase {
                 }
             }
             for (int c = 0; c < 3; c++) {
-                dst(x, y, c) = (unsigned char)(pix[c]/cc);
+                dst(x, y, c) = typename ImageType::pixel_unit(pix[c]/cc);
             }
-        }
+        });
     }
+
     /**
      * Método Desaturação
      */
     static void desaturation(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            unsigned int gray =(std::max(std::max(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE))+
+        if (simd_grayscale(simd::GrayOp::DESATURATION, i2d, dst)) return;
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            const typename ImageType::pixel_unit gray = (std::max(std::max(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE))+
                                 std::min(std::min(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE)))/2;
             dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = gray;
-        }
+        });
     }
     /**
      * Método Decomposição de max
      */
     static void de_composition_max(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            unsigned int gray = std::max(std::max(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE));
+        if (simd_grayscale(simd::GrayOp::DE_COMPOSITION_MAX, i2d, dst)) return;
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            const typename ImageType::pixel_unit gray = std::max(std::max(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE));
             dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = gray;
-        }
+        });
     }
     /**
      * Decomposição de min
      */
     static void de_composition_min(const ImageType &i2d, ImageType &dst) {
-        biforImg(i2d, x, y) {
-            unsigned int gray = std::min(std::min(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE));
+        if (simd_grayscale(simd::GrayOp::DE_COMPOSITION_MIN, i2d, dst)) return;
+        for_each_pixel(i2d, [&](uint x, uint y) {
+            const typename ImageType::pixel_unit gray = std::min(std::min(i2d(x, y, RED), i2d(x, y, GREEN)), i2d(x, y, BLUE));
             dst(x, y, RED) = dst(x, y, GREEN) = dst(x, y, BLUE) = gray;
+        });
+    }
+
+    /**
+     * Classe do histograma (PixelTraits::bins) de um valor.
+     */
+    static uint hist_bin(typename ImageType::pixel_unit v) {
+        using pu = typename ImageType::pixel_unit;
+        if constexpr (std::is_integral<pu>::value) return v;
+        else return uint(std::min(std::max(v/PixelTraits<pu>::white, pu(0)), pu(1))*(PixelTraits<pu>::bins - 1) + pu(0.5));
+    }
+
+    /**
+     * Histogramas por canal de i2d, em hist[c*bins + classe]. Cada thread conta um bloco de linhas em histogramas
+     * privados, somados ao final em vez de incrementos atômicos. Com até 256 classes, cada canal tem 4
+     * sub-histogramas alternados elemento a elemento: incrementos seguidos da mesma classe (regiões uniformes)
+     * caem em contadores diferentes e não esperam um pelo outro.
+     */
+    static std::vector<uint64_t> histogram_of(const ImageType &i2d) {
+        using pu = typename ImageType::pixel_unit;
+        constexpr uint bins = PixelTraits<pu>::bins, lanes = bins <= 256 ? 4 : 1;
+        const uint w = i2d.getWidth(), h = i2d.getHeight(), channels = i2d.getChannels();
+        const size_t size = size_t(channels)*bins, t = parallel::threads();
+        std::vector<std::vector<uint32_t>> priv(t);
+        parallel::for_each_thread([&](long i) {
+            std::vector<uint32_t> &hist = priv[i];
+            hist.assign(lanes*size, 0);
+            const uint y0 = h*i/t, y1 = h*(i + 1)/t;
+            if constexpr (Trav::strided) {
+                if (Trav::layout_order()) {
+                    // Deslocamento do sub-histograma de cada elemento, periódico: com os canais intercalados, a
+                    // sequência percorre todos eles a partir de c = 0
+                    constexpr bool cycle = Trav::axes.third == convert::C;
+                    std::vector<size_t> offset(lanes*(cycle ? channels : 1));
+                    for (size_t j = 0; j < offset.size(); j++) offset[j] = j % lanes*size + (cycle ? j % channels*bins : 0);
+                    Trav::runs(i2d, 0, y0, w, y1, channels, [&](uint x, uint y, uint c, uint n) {
+                        const pu *s = &i2d(x, y, c);
+                        uint32_t *base = hist.data() + (cycle ? 0 : size_t(c)*bins);
+                        for (uint k = 0, j = 0; k < n; k++) {
+                            base[offset[j] + hist_bin(s[k])]++;
+                            if (++j == offset.size()) j = 0;
+                        }
+                    });
+                    return;
+                }
+            }
+            uint k = 0;
+            Trav::elements(0, y0, w, y1, channels, [&](uint x, uint y, uint c) {
+                hist[(k++ % lanes)*size + size_t(c)*bins + hist_bin(i2d(x, y, c))]++;
+            });
+        });
+        std::vector<uint64_t> total(size, 0);
+        for (const auto &hist : priv)
+            for (size_t j = 0; j < hist.size(); j++) total[j % size] += hist[j];
+        return total;
+    }
+
+    /**
+     * dst(x, y, c) = lut[c*bins + classe de i2d(x, y, c)] no retângulo [x0, x1) x [y0, y1). Nos layouts strided de
+     * 8 bits, cada sequência contígua passa por simd::lut_apply (lut com simd::LUT_PADDING posições a mais).
+     */
+    static void lut_rect(const ImageType &i2d, ImageType &dst, const std::vector<typename ImageType::pixel_unit> &lut,
+                         uint x0, uint y0, uint x1, uint y1) {
+        using pu = typename ImageType::pixel_unit;
+        const uint channels = i2d.getChannels();
+        if constexpr (Trav::strided && std::is_same<pu, uint8_t>::value) {
+            if (Trav::layout_order()) {
+                Trav::runs(i2d, x0, y0, x1, y1, channels, [&](uint x, uint y, uint c, uint n) {
+                    constexpr bool cycle = Trav::axes.third == convert::C;
+                    simd::lut_apply(lut.data() + (cycle ? 0 : size_t(c)*256), &i2d(x, y, c), &dst(x, y, c), n, cycle ? channels : 1);
+                });
+                return;
+            }
+        }
+        Trav::elements(x0, y0, x1, y1, channels, [&](uint x, uint y, uint c) {
+            dst(x, y, c) = lut[size_t(c)*PixelTraits<pu>::bins + hist_bin(i2d(x, y, c))];
+        });
+    }
+
+    enum class HistogramMap { FREQUENCY, CUMULATIVE, EQUALIZATION };
+
+    /**
+     * Redução seguida de mapeamento: calcula o histograma de cada canal, monta a tabela do canal e a aplica em tiles.
+     * FREQUENCY leva cada valor à frequência da sua classe (relativa à mais frequente do canal); CUMULATIVE, à
+     * fração dos elementos do canal até a sua classe; EQUALIZATION, à equalização clássica
+     * (cdf - cdf_min)/(N - cdf_min), que espalha as classes ocupadas por toda a faixa de intensidades.
+     */
+    static void histogram_map(HistogramMap map, const ImageType &i2d, ImageType &dst) {
+        using pu = typename ImageType::pixel_unit;
+        constexpr uint bins = PixelTraits<pu>::bins;
+        const double white = PixelTraits<pu>::white, rounding = std::is_integral<pu>::value ? 0.5 : 0;
+        const uint channels = i2d.getChannels();
+        const uint64_t n = uint64_t(i2d.getWidth())*i2d.getHeight();
+        const std::vector<uint64_t> hist = histogram_of(i2d);
+        const auto scale = [&](uint64_t a, uint64_t d) { return d ? pu(double(a)/d*white + rounding) : pu(0); };
+        std::vector<pu> lut(size_t(channels)*bins + simd::LUT_PADDING, 0);
+        for (uint c = 0; c < channels; c++) {
+            const uint64_t *hc = &hist[size_t(c)*bins];
+            pu *lc = &lut[size_t(c)*bins];
+            if (map == HistogramMap::FREQUENCY) {
+                const uint64_t top = *std::max_element(hc, hc + bins);
+                for (uint b = 0; b < bins; b++) lc[b] = scale(hc[b], top);
+                continue;
+            }
+            uint64_t first = 0, cdf = 0;
+            for (uint b = 0; b < bins && !first; b++) first = hc[b];
+            for (uint b = 0; b < bins; b++) {
+                cdf += hc[b];
+                if (map == HistogramMap::CUMULATIVE) lc[b] = scale(cdf, n);
+                else if (n > first) lc[b] = scale(cdf > first ? cdf - first : 0, n - first);
+                else lc[b] = pu(b*white/(bins - 1)); // Canal de uma só classe: mantém os valores
+            }
         }
+        tiled(i2d, 0, [&](uint x0, uint y0, uint x1, uint y1) { lut_rect(i2d, dst, lut, x0, y0, x1, y1); }, no_border);
+    }
+
+    /**
+     * Histograma: cada elemento recebe a frequência da sua classe no canal.
+     */
+    static void histogram(const ImageType &i2d, ImageType &dst) {
+        histogram_map(HistogramMap::FREQUENCY, i2d, dst);
+    }
+
+    /**
+     * Histograma acumulado: cada elemento recebe a fração dos elementos do canal com valor menor ou igual.
+     */
+    static void cumulative_histogram(const ImageType &i2d, ImageType &dst) {
+        histogram_map(HistogramMap::CUMULATIVE, i2d, dst);
+    }
+
+    /**
+     * Equalização de histograma, por canal: https://en.wikipedia.org/wiki/Histogram_equalization
+     */
+    static void histogram_equalization(const ImageType &i2d, ImageType &dst) {
+        histogram_map(HistogramMap::EQUALIZATION, i2d, dst);
+    }
+
+    template<simd::GrayOp op>
+    static void gray_rect_op(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        gray_rect(op, i2d, dst, x0, y0, x1, y1);
+    }
+
+    static void sobel_v2_tile(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        static const SobelV2Table bsrch = sobel_v2_table();
+        sobel_v2_rect(i2d, dst, bsrch, x0, y0, x1, y1);
+    }
+
+    static void blur_tile(const ImageType &i2d, ImageType &dst, uint x0, uint y0, uint x1, uint y1) {
+        const uint r = ImagingAlgorithmsBase::blur_radius, channels = std::min(3u, i2d.getChannels());
+        for (uint c = 0; c < channels; c++) box_blur_rect(i2d, dst, r, c, x0, y0, x1, y1);
+    }
+
+    /**
+     * radius de um Kernel cujo raio é o configurável ImagingAlgorithmsBase::blur_radius.
+     */
+    static constexpr uint BLUR_RADIUS = std::numeric_limits<uint>::max();
+
+    /**
+     * Entrada do registro de algoritmos: nome (o mesmo da linha de comando e dos resultados), natureza, raio da
+     * vizinhança lida em cada direção, operações inteiras estimadas por pixel (todos os canais, para o roofline),
+     * a execução sobre a imagem inteira e a de um retângulo [x0, x1) x [y0, y1), usada pelo passe fundido (nula
+     * nas reduções).
+     */
+    struct Kernel {
+        const char *name;
+        KernelKind kind;
+        uint radius;
+        uint ops;
+        AlgorithmFn run;
+        RectFn rect;
+
+        uint halo() const { return radius == BLUR_RADIUS ? ImagingAlgorithmsBase::blur_radius : radius; }
+    };
+
+    static constexpr size_t KERNELS = 12;
+    static_assert(KERNELS <= 64, "enabled is a 64-bit mask");
+
+    /**
+     * Registro de todos os algoritmos, na ordem de execução e de relatório. Um novo algoritmo é registrado apenas
+     * aqui: habilitação, passe fundido, halo do streaming e linha de comando derivam desta tabela.
+     */
+    static const std::array<Kernel, KERNELS>& kernels() {
+        static constexpr std::array<Kernel, KERNELS> table = {{
+            {"averaging", KernelKind::POINT, 0, 3, averaging, gray_rect_op<simd::GrayOp::AVERAGING>},
+            {"luma", KernelKind::POINT, 0, 6, luma, gray_rect_op<simd::GrayOp::LUMA>},
+            {"sobel", KernelKind::STENCIL, 1, 54, sobel, sobel_rect},
+            {"sobel_v2", KernelKind::STENCIL, 1, 78, sobel_v2, sobel_v2_tile},
+            {"sobel_fixed", KernelKind::STENCIL, 1, 48, sobel_fixed, sobel_fixed_rect},
+            {"blur", KernelKind::STENCIL, BLUR_RADIUS, 15, blur, blur_tile},
+            {"desaturation", KernelKind::POINT, 0, 6, desaturation, gray_rect_op<simd::GrayOp::DESATURATION>},
+            {"de_composition_max", KernelKind::POINT, 0, 2, de_composition_max, gray_rect_op<simd::GrayOp::DE_COMPOSITION_MAX>},
+            {"de_composition_min", KernelKind::POINT, 0, 2, de_composition_min, gray_rect_op<simd::GrayOp::DE_COMPOSITION_MIN>},
+            {"histogram", KernelKind::REDUCTION, 0, 9, histogram, nullptr},
+            {"cumulative_histogram", KernelKind::REDUCTION, 0, 9, cumulative_histogram, nullptr},
+            {"histogram_equalization", KernelKind::REDUCTION, 0, 9, histogram_equalization, nullptr},
+        }};
+        return table;
+    }
+
+    /**
+     * Posição de `a` no registro, ou KERNELS se não existir.
+     */
+    static size_t kernelIndex(const std::string& a) {
+        size_t k = 0;
+        while (k < KERNELS && a != kernels()[k].name) k++;
+        return k;
+    }
+
+    bool isEnabled(size_t k) const {
+        return !enabled || (enabled >> k & 1);
+    }
+
+    /**
+     * Índices no registro dos algoritmos habilitados, em ordem.
+     */
+    std::vector<size_t> enabledKernels() const {
+        std::vector<size_t> ks;
+        for (size_t k = 0; k < KERNELS; k++) if (isEnabled(k)) ks.push_back(k);
+        return ks;
+    }
+
+    /**
+     * Nomes dos algoritmos habilitados, unidos por "+", para os registros das execuções combinadas.
+     */
+    std::string enabledNames() const {
+        std::string names;
+        for (const size_t k : enabledKernels()) names += (names.empty() ? "" : "+") + std::string(kernels()[k].name);
+        return names;
     }
 
     /**
@@ -202,14 +912,96 @@ struct ImagingAlgorithms : public ImagingAlgorithmsBase {
      * dst: Destino/Buffer temporário para a escrita da saída.
      */
     void channel_close_algorithms(const ImageType &i2d, ImageType &dst) const {
-        if (isEnabled("averaging")) averaging(i2d, dst);
-        if (isEnabled("luma")) luma(i2d, dst);
-        if (isEnabled("sobel")) sobel(i2d, dst);
-        if (isEnabled("sobel_v2")) sobel_v2(i2d, dst);
-        if (isEnabled("blur")) blur(i2d, dst);
-        if (isEnabled("desaturation")) desaturation(i2d, dst);
-        if (isEnabled("de_composition_max")) de_composition_max(i2d, dst);
-        if (isEnabled("de_composition_min")) de_composition_min(i2d, dst);
+        for (size_t k = 0; k < KERNELS; k++)
+            if (isEnabled(k)) kernels()[k].run(i2d, dst);
+    }
+
+    /**
+     * Executa todos os algoritmos habilitados em uma única varredura em tiles: cada tile (com o halo do maior
+     * estêncil habilitado) é trazido para a cache uma vez e alimenta todos os algoritmos antes do próximo.
+     * dsts[i] recebe a saída do i-ésimo algoritmo habilitado, na ordem do registro.
+     */
+    void channel_close_algorithms_fused(const ImageType &i2d, const std::vector<ImageType*> &dsts) const {
+        const std::vector<size_t> ks = enabledKernels();
+        assert(dsts.size() >= ks.size());
+        const uint halo = halo_rows();
+        const auto rect = [&](uint x0, uint y0, uint x1, uint y1) {
+            for (size_t i = 0; i < ks.size(); i++)
+                if (kernels()[ks[i]].rect) kernels()[ks[i]].rect(i2d, *dsts[i], x0, y0, x1, y1);
+        };
+        tiled(i2d, halo, rect, rect);
+        // As reduções precisam da imagem inteira antes do primeiro pixel de saída: executadas em seus próprios passes
+        for (size_t i = 0; i < ks.size(); i++)
+            if (!kernels()[ks[i]].rect) kernels()[ks[i]].run(i2d, *dsts[i]);
+    }
+
+    /**
+     * Recalcula apenas a parte de dst afetada pela alteração dos retângulos `dirty` de i2d, desde a última execução
+     * completa sobre dst. Cada retângulo é expandido pelo halo do maior estêncil habilitado (todos os algoritmos
+     * sobrescrevem a mesma região, como na execução completa), limitado à imagem e dividido em tiles. Com uma
+     * redução habilitada, qualquer alteração muda a imagem inteira: recalcula tudo.
+     */
+    void channel_close_algorithms_dirty(const ImageType &i2d, ImageType &dst, const std::vector<Rect> &dirty) const {
+        const std::vector<size_t> ks = enabledKernels();
+        if (dirty.empty()) return;
+        for (const size_t k : ks)
+            if (kernels()[k].kind == KernelKind::REDUCTION) return channel_close_algorithms(i2d, dst);
+        const uint halo = halo_rows();
+        for (const Rect &r : dirty) {
+            tiled_rect(expand(i2d, r, halo), [&](uint x0, uint y0, uint x1, uint y1) {
+                for (const size_t k : ks) kernels()[k].rect(i2d, dst, x0, y0, x1, y1);
+            });
+        }
+    }
+
+    /**
+     * Como channel_close_algorithms_dirty, com uma saída por algoritmo habilitado (como em
+     * channel_close_algorithms_fused): cada saída é recalculada na região expandida pelo halo do seu algoritmo,
+     * e as das reduções por inteiro.
+     */
+    void channel_close_algorithms_dirty(const ImageType &i2d, const std::vector<ImageType*> &dsts,
+                                        const std::vector<Rect> &dirty) const {
+        const std::vector<size_t> ks = enabledKernels();
+        assert(dsts.size() >= ks.size());
+        if (dirty.empty()) return;
+        for (size_t i = 0; i < ks.size(); i++) {
+            const Kernel &kr = kernels()[ks[i]];
+            if (kr.kind == KernelKind::REDUCTION) {
+                kr.run(i2d, *dsts[i]);
+                continue;
+            }
+            for (const Rect &r : dirty) {
+                tiled_rect(expand(i2d, r, kr.halo()), [&](uint x0, uint y0, uint x1, uint y1) {
+                    kr.rect(i2d, *dsts[i], x0, y0, x1, y1);
+                });
+            }
+        }
+    }
+
+    /**
+     * Estratégia que AUTO aplica ao lote: INTER com mais de uma imagem e todas pequenas, caso em que cada imagem
+     * tem poucos tiles para ocupar as threads e o custo de abrir as regiões paralelas domina.
+     */
+    static BatchPolicy batch_policy(const std::vector<const ImageType*> &srcs) {
+        if (srcs.size() < 2) return BatchPolicy::INTRA;
+        for (const auto *i2d : srcs)
+            if (size_t(i2d->getWidth())*i2d->getHeight() > batch_pixels) return BatchPolicy::INTRA;
+        return BatchPolicy::INTER;
+    }
+
+    /**
+     * Executa os algoritmos habilitados sobre cada srcs[i], escrevendo em dsts[i].
+     */
+    void channel_close_algorithms_batch(const std::vector<const ImageType*> &srcs, const std::vector<ImageType*> &dsts,
+                                        BatchPolicy policy = BatchPolicy::AUTO) const {
+        assert(dsts.size() >= srcs.size());
+        if (policy == BatchPolicy::AUTO) policy = batch_policy(srcs);
+        if (policy == BatchPolicy::INTER) {
+            // Os for_range dos algoritmos, aninhados neste, executam na própria thread
+            parallel::for_range(srcs.size(), [&](long i) { channel_close_algorithms(*srcs[i], *dsts[i]); });
+        } else {
+            for (size_t i = 0; i < srcs.size(); i++) channel_close_algorithms(*srcs[i], *dsts[i]);
+        }
     }
 
     ImageType channel_close_algorithms(const ImageType &i2d) const {
@@ -231,23 +1023,404 @@ struct ImagingAlgorithms : public ImagingAlgorithmsBase {
         return elapsed;
     }
 
+    virtual std::vector<BenchRecord> benchmark_algorithms(const char *file, const BenchOptions& opts) const override {
+        ImageType i2d(file);
+        ImageType dst(i2d.getWidth(), i2d.getHeight(), i2d.getChannels());
+        const double image_bytes = double(i2d.getWidth())*i2d.getHeight()*i2d.getChannels()*sizeof(typename ImageType::pixel_unit);
+        const double pixels = double(i2d.getWidth())*i2d.getHeight();
+
+        std::vector<BenchRecord> records;
+        for (const size_t k : enabledKernels()) {
+            const Kernel &kr = kernels()[k];
+            // Cada algoritmo lê todos os canais da origem e escreve todos os canais do destino.
+            records.push_back(time_algorithm(file, i2d, kr.name, 2*image_bytes, kr.ops*pixels, opts, [&] { kr.run(i2d, dst); }));
+        }
+
+        if (opts.fused && !records.empty()) {
+            std::vector<std::unique_ptr<ImageType>> outs;
+            std::vector<ImageType*> dsts;
+            const std::vector<size_t> ks = enabledKernels();
+            for (size_t i = 0; i < ks.size(); i++) {
+                outs.emplace_back(new ImageType(i2d.getWidth(), i2d.getHeight(), i2d.getChannels()));
+                dsts.push_back(outs.back().get());
+            }
+            // Referência justa: os mesmos algoritmos, cada um em sua própria varredura e com sua própria saída
+            double ops = 0;
+            for (const size_t k : ks) ops += kernels()[k].ops*pixels;
+            records.push_back(time_algorithm(file, i2d, "sequential:" + enabledNames(), 2*dsts.size()*image_bytes, ops, opts, [&] {
+                for (size_t i = 0; i < ks.size(); i++) kernels()[ks[i]].run(i2d, *dsts[i]);
+            }));
+            // Uma leitura da origem e uma escrita por saída
+            records.push_back(time_algorithm(file, i2d, "fused:" + enabledNames(), (1 + dsts.size())*image_bytes, ops, opts,
+                                             [&] { channel_close_algorithms_fused(i2d, dsts); }));
+        }
+
+        if (opts.dirty && !records.empty()) {
+            const uint w = i2d.getWidth(), h = i2d.getHeight(), ew = std::min(opts.dirty, w), eh = std::min(opts.dirty, h);
+            const std::vector<Rect> dirty = {{(w - ew)/2, (h - eh)/2, (w - ew)/2 + ew, (h - eh)/2 + eh}};
+            const Rect r = expand(i2d, dirty[0], halo_rows());
+            double ops = 0;
+            for (const size_t k : enabledKernels()) ops += kernels()[k].ops;
+            records.push_back(time_algorithm(file, i2d, "full:" + enabledNames(), 2*image_bytes, ops*pixels, opts,
+                                             [&] { channel_close_algorithms(i2d, dst); }));
+            // Apenas a região expandida é lida e escrita
+            const double area = double(r.x1 - r.x0)*(r.y1 - r.y0);
+            records.push_back(time_algorithm(file, i2d, "dirty:" + enabledNames() + "@" + std::to_string(ew) + "x" + std::to_string(eh),
+                                             2*image_bytes*area/pixels, ops*area, opts,
+                                             [&] { channel_close_algorithms_dirty(i2d, dst, dirty); }));
+        }
+
+        if (opts.numa && ImageType::is_memblock) {
+            const std::string src_pages = Numa::report(i2d.data(), i2d.elements()*sizeof(typename ImageType::pixel_unit));
+            const std::string dst_pages = Numa::report(dst.data(), dst.elements()*sizeof(typename ImageType::pixel_unit));
+            for (auto& rec : records) rec.set("numa_src_pages", src_pages).set("numa_dst_pages", dst_pages);
+        }
+
+        if (opts.conversion) {
+            // Planar como na CImg e RGB intercalado: as duas origens/destinos mais comuns de troca de layout
+            time_conversion<Image3D<PixelOrder::CYX, true, typename ImageType::pixel_unit>>(file, i2d, image_bytes, opts, records);
+            time_conversion<Image3D<PixelOrder::YXC, true, typename ImageType::pixel_unit>>(file, i2d, image_bytes, opts, records);
+        }
+        return records;
+    }
+
+    virtual std::vector<BenchRecord> benchmark_pipeline(const std::vector<std::string>& files, uint loaders, uint depth) const override {
+        struct Loaded {
+            std::string file;
+            std::unique_ptr<ImageType> img;
+        };
+        const auto load = [](const std::string& file) {
+            try {
+                return std::unique_ptr<ImageType>(new ImageType(file.c_str()));
+            } catch (const std::exception& e) {
+                std::cerr << "# Failed to load " << file << ": " << e.what() << "\n";
+                return std::unique_ptr<ImageType>();
+            }
+        };
+
+        BenchClock wall;
+        BoundedQueue<Loaded> queue(depth);
+        std::atomic<size_t> next(0);
+        std::atomic<uint> running(loaders);
+        std::vector<std::thread> pool;
+        for (uint i = 0; i < loaders; i++) {
+            pool.emplace_back([&] {
+                for (size_t k; (k = next++) < files.size();) {
+                    auto img = load(files[k]);
+                    if (img) queue.push({files[k], std::move(img)});
+                }
+                if (--running == 0) queue.close();
+            });
+        }
+
+        const std::vector<size_t> algos = enabledKernels();
+        std::vector<int64_t> kernel(algos.size(), 0);
+        int64_t stall = 0; // Tempo esperando por uma imagem (ou decodificando-a, sem loaders)
+        size_t images = 0, k = 0;
+        double pixels = 0;
+        std::unique_ptr<ImageType> dst;
+        while (true) {
+            BenchClock wait;
+            Loaded item;
+            if (loaders) {
+                if (!queue.pop(item)) break;
+            } else {
+                if (k >= files.size()) break;
+                item = {files[k], load(files[k])};
+                k++;
+                if (!item.img) continue;
+            }
+            stall += wait.getElapsed();
+
+            const ImageType &i2d = *item.img;
+            if (!dst || dst->getWidth() != i2d.getWidth() || dst->getHeight() != i2d.getHeight() || dst->getChannels() != i2d.getChannels()) {
+                dst.reset(new ImageType(i2d.getWidth(), i2d.getHeight(), i2d.getChannels()));
+            }
+            for (size_t i = 0; i < algos.size(); i++) {
+                BenchClock clock;
+                kernels()[algos[i]].run(i2d, *dst);
+                kernel[i] += clock.getElapsed();
+            }
+            images++;
+            pixels += double(i2d.getWidth())*i2d.getHeight();
+        }
+        for (auto& t : pool) t.join();
+        const int64_t elapsed = wall.getElapsed();
+        const double secs = BenchClock::toSeconds(elapsed);
+
+        std::vector<BenchRecord> records;
+        int64_t compute = 0;
+        const auto record = [&](const std::string& algorithm, int64_t kernel_time) {
+            BenchRecord rec;
+            rec.set("implementation", getDesc()).set("algorithm", algorithm).set("pixel_type", pixelType()).set("images", images)
+               .set("loaders", loaders).set("depth", depth).set("unit", STRINGIFY(CLOCK_PRECISION))
+               .set("wall", elapsed).set("stall", stall).set("kernel_time", kernel_time)
+               .set("images_per_s", secs > 0 ? images/secs : 0.0)
+               .set("mpixels_per_s", secs > 0 ? pixels/secs/1e6 : 0.0);
+            records.push_back(std::move(rec));
+        };
+        for (size_t i = 0; i < algos.size(); i++) {
+            record(kernels()[algos[i]].name, kernel[i]);
+            compute += kernel[i];
+        }
+        record("pipeline", compute);
+        return records;
+    }
+
+    virtual std::vector<BenchRecord> benchmark_streaming(const char *file, uint strip_rows, const std::string& output) const override {
+        typedef typename ImageType::pixel_unit pu;
+        typedef Image3D<PixelOrder::YXC, true, pu> Rows; // Layout das linhas do arquivo
+        constexpr bool bytes = std::is_same<pu, uint8_t>::value;
+        PeakRss::reset();
+        BenchClock wall;
+        PnmReader in(file);
+        const uint w = in.getWidth(), h = in.getHeight(), c = in.getChannels(), halo = halo_rows();
+        const uint strip = std::max(1u, std::min(strip_rows, h));
+        std::unique_ptr<PnmWriter> out;
+        if (!output.empty()) out.reset(new PnmWriter(output.c_str(), w, h));
+
+        const std::vector<size_t> algos = enabledKernels();
+        std::vector<int64_t> kernel(algos.size(), 0);
+        int64_t io = 0, conversion = 0;
+        size_t strips = 0;
+        std::vector<pu> rows(size_t(w)*std::min(strip + 2*halo, h)*c);
+        // Pixels mais largos que o arquivo (8 bits) passam por `raw`, na mesma escala do construtor a partir de arquivo
+        std::vector<uint8_t> raw(bytes ? 0 : rows.size());
+        std::unique_ptr<ImageType> src, dst;
+        for (uint y0 = 0; y0 < h; y0 += strip, strips++) {
+            // Faixa [y0, y1) com halo [a, b); apenas a primeira e a última faixa têm altura diferente
+            const uint y1 = std::min(y0 + strip, h), a = y0 - std::min(y0, halo), b = std::min(y1 + halo, h);
+            if (!src || src->getHeight() != b - a) {
+                src.reset(new ImageType(w, b - a, c));
+                dst.reset(new ImageType(w, b - a, c));
+            }
+            BenchClock read;
+            if constexpr (bytes) in.readRows(a, b - a, rows.data());
+            else in.readRows(a, b - a, raw.data());
+            io += read.getElapsed();
+
+            BenchClock to;
+            if constexpr (!bytes) {
+                const size_t n = size_t(w)*(b - a)*c;
+                for (size_t i = 0; i < n; i++) rows[i] = std::is_integral<pu>::value ? pu(raw[i]) : pu(raw[i]/255.0f);
+            }
+            convert::image(Rows(rows.data(), w, b - a, c), *src);
+            conversion += to.getElapsed();
+            for (size_t i = 0; i < algos.size(); i++) {
+                BenchClock clock;
+                kernels()[algos[i]].run(*src, *dst);
+                kernel[i] += clock.getElapsed();
+            }
+            if (out) {
+                BenchClock from;
+                Rows result(rows.data(), w, b - a, c);
+                convert::image(*dst, result);
+                const pu *first = &result(0, y0 - a, 0);
+                if constexpr (!bytes) {
+                    const size_t n = size_t(w)*(y1 - y0)*c;
+                    for (size_t i = 0; i < n; i++) {
+                        const double v = std::is_integral<pu>::value ? double(first[i]) : first[i]*255.0 + 0.5;
+                        raw[i] = uint8_t(std::max(0.0, std::min(255.0, v)));
+                    }
+                }
+                conversion += from.getElapsed();
+                BenchClock write;
+                if constexpr (bytes) out->writeRows(first, y1 - y0);
+                else out->writeRows(raw.data(), y1 - y0);
+                io += write.getElapsed();
+            }
+        }
+        out.reset();
+        const int64_t elapsed = wall.getElapsed();
+        const double secs = BenchClock::toSeconds(elapsed), pixels = double(w)*h;
+
+        std::vector<BenchRecord> records;
+        int64_t compute = 0;
+        const auto record = [&](const std::string& algorithm, int64_t kernel_time) {
+            BenchRecord rec;
+            rec.set("implementation", getDesc()).set("algorithm", algorithm).set("file", file)
+               .set("width", w).set("height", h).set("channels", c)
+               .set("pixel_type", pixelType()).set("bytes_per_pixel", c*sizeof(typename ImageType::pixel_unit))
+               .set("strip_rows", strip).set("halo", halo).set("strips", strips)
+               .set("unit", STRINGIFY(CLOCK_PRECISION)).set("wall", elapsed).set("io_time", io)
+               .set("conversion_time", conversion).set("kernel_time", kernel_time)
+               .set("mpixels_per_s", secs > 0 ? pixels/secs/1e6 : 0.0)
+               .set("strip_bytes", 2*double(w)*std::min(strip + 2*halo, h)*c*sizeof(pu))
+               .set("peak_rss_kb", PeakRss::kb());
+            records.push_back(std::move(rec));
+        };
+        for (size_t i = 0; i < algos.size(); i++) {
+            record(kernels()[algos[i]].name, kernel[i]);
+            compute += kernel[i];
+        }
+        record("streaming", compute);
+        return records;
+    }
+
+    virtual std::vector<BenchRecord> benchmark_batch(const std::vector<std::string>& files, const BenchOptions& opts) const override {
+        std::vector<std::unique_ptr<ImageType>> imgs, outs;
+        std::vector<const ImageType*> srcs;
+        std::vector<ImageType*> dsts;
+        double pixels = 0;
+        for (const auto& file : files) {
+            try {
+                imgs.emplace_back(new ImageType(file.c_str()));
+            } catch (const std::exception& e) {
+                std::cerr << "# Failed to load " << file << ": " << e.what() << "\n";
+                continue;
+            }
+            const ImageType &i2d = *imgs.back();
+            outs.emplace_back(new ImageType(i2d.getWidth(), i2d.getHeight(), i2d.getChannels()));
+            srcs.push_back(&i2d);
+            dsts.push_back(outs.back().get());
+            pixels += double(i2d.getWidth())*i2d.getHeight();
+        }
+        if (srcs.empty()) return {};
+
+        const std::string name = "batch:" + enabledNames();
+        const BatchPolicy chosen = batch_policy(srcs);
+        std::vector<BenchRecord> records;
+        for (const BatchPolicy policy : {BatchPolicy::INTRA, BatchPolicy::INTER}) {
+            channel_close_algorithms_batch(srcs, dsts, policy); // Aquecimento
+            std::vector<int64_t> samples;
+            for (uint r = 0; r < opts.repetitions; r++) {
+                BenchClock clock;
+                channel_close_algorithms_batch(srcs, dsts, policy);
+                samples.push_back(clock.getElapsed());
+            }
+            const BenchStats st(std::move(samples));
+            const double secs = BenchClock::toSeconds(st.median);
+
+            BenchRecord rec;
+            rec.set("implementation", getDesc()).set("algorithm", name).set("pixel_type", pixelType())
+               .set("images", srcs.size()).set("mean_pixels", pixels/srcs.size())
+               .set("policy", batchPolicyName(policy)).set("auto", chosen == policy ? 1 : 0)
+               .set("scheduler", parallel::backendName()).set("threads", parallel::threads())
+               .set("repetitions", opts.repetitions).set("unit", STRINGIFY(CLOCK_PRECISION))
+               .set("min", st.min).set("median", st.median).set("p95", st.p95).set("mean", st.mean).set("stddev", st.stddev)
+               .set("images_per_s", secs > 0 ? srcs.size()/secs : 0.0)
+               .set("mpixels_per_s", secs > 0 ? pixels/secs/1e6 : 0.0);
+            records.push_back(std::move(rec));
+        }
+        return records;
+    }
+
+    /**
+     * Linhas de vizinhança que os algoritmos habilitados leem acima e abaixo de cada pixel.
+     */
+    uint halo_rows() const {
+        uint halo = 0;
+        for (const size_t k : enabledKernels())
+            if (kernels()[k].kind == KernelKind::STENCIL) halo = std::max(halo, kernels()[k].halo());
+        return halo;
+    }
+
+    /**
+     * Cronometra `run` (uma execução de aquecimento e opts.repetitions cronometradas) e monta o registro de resultado.
+     * bytes: quantidade de bytes lidos e escritos por execução, para o cálculo da vazão; ops: operações inteiras
+     * estimadas por execução, para o roofline (opts.roofline).
+     */
+    template<typename Run>
+    BenchRecord time_algorithm(const char *file, const ImageType &i2d, const std::string& algorithm, double bytes, double ops,
+                               const BenchOptions& opts, Run run) const {
+        run(); // Aquecimento: caches, TLB e páginas do destino já tocadas
+
+        std::vector<int64_t> samples;
+        if (opts.perf) opts.perf->reset();
+        for (uint r = 0; r < opts.repetitions; r++) {
+            if (opts.perf) opts.perf->start();
+            BenchClock clock;
+            run();
+            samples.push_back(clock.getElapsed());
+            if (opts.perf) opts.perf->stop();
+        }
+        const BenchStats st(std::move(samples));
+        const double secs = BenchClock::toSeconds(st.median), pixels = double(i2d.getWidth())*i2d.getHeight();
+
+        BenchRecord rec;
+        rec.set("implementation", getDesc()).set("algorithm", algorithm).set("file", file)
+           .set("width", i2d.getWidth()).set("height", i2d.getHeight()).set("channels", i2d.getChannels())
+           .set("pixel_type", pixelType()).set("bytes_per_pixel", i2d.getChannels()*sizeof(typename ImageType::pixel_unit))
+           .set("scheduler", parallel::backendName()).set("threads", parallel::threads())
+           .set("repetitions", opts.repetitions).set("unit", STRINGIFY(CLOCK_PRECISION))
+           .set("min", st.min).set("median", st.median).set("p95", st.p95).set("mean", st.mean).set("stddev", st.stddev)
+           .set("mpixels_per_s", secs > 0 ? pixels/secs/1e6 : 0.0)
+           .set("gb_per_s", secs > 0 ? bytes/secs/1e9 : 0.0);
+        if (opts.roofline) opts.roofline->annotate(rec, bytes, ops, secs, parallel::threads());
+        if (opts.samples) rec.set("samples", results::join(st.samples));
+        if (opts.perf && opts.repetitions) {
+            // Médias por repetição
+            for (const auto& c : opts.perf->read()) rec.set(c.first, c.second/opts.repetitions);
+        }
+        return rec;
+    }
+
+    /**
+     * Cronometra a conversão (convert::image) de Other para este layout e de volta.
+     */
+    template<typename Other>
+    void time_conversion(const char *file, const ImageType &i2d, double image_bytes, const BenchOptions& opts,
+                         std::vector<BenchRecord>& records) const {
+        Other other(i2d);
+        ImageType back(i2d.getWidth(), i2d.getHeight(), i2d.getChannels());
+        records.push_back(time_algorithm(file, i2d, "convert:from:" + Other::__implementation_type(), 2*image_bytes, 0, opts,
+                                         [&] { convert::image(other, back); }));
+        records.push_back(time_algorithm(file, i2d, "convert:to:" + Other::__implementation_type(), 2*image_bytes, 0, opts,
+                                         [&] { convert::image(i2d, other); }));
+    }
+
+    TileSize getTileSize() const override { return tile_size; }
+    void setTileSize(TileSize t) override { tile_size = t; }
+
+    TileSize autotuneTileSize(const char *file) override {
+        ImageType i2d(file);
+        ImageType dst(i2d.getWidth(), i2d.getHeight(), i2d.getChannels());
+        const uint candidates[] = {16, 64, 256, 1024};
+        TileSize best = tile_size;
+        int64_t best_time = std::numeric_limits<int64_t>::max();
+        for (const uint tw : candidates) {
+            for (const uint th : candidates) {
+                tile_size = {tw, th};
+                sobel(i2d, dst); // Aquecimento
+                BenchClock clock;
+                sobel(i2d, dst);
+                const auto elapsed = clock.getElapsed();
+                if (elapsed < best_time) {
+                    best_time = elapsed;
+                    best = tile_size;
+                }
+            }
+        }
+        tile_size = best;
+        return best;
+    }
+
     virtual const std::string getDesc() const override {
         return ImageType::__implementation_type();
     }
 
+    const std::string pixelType() const override {
+        return PixelTraits<typename ImageType::pixel_unit>::name;
+    }
+
     bool isEnabled(const std::string& a) const override {
-        return enabled.empty() || enabled.find(a) != enabled.end();
+        const size_t k = kernelIndex(a);
+        return k < KERNELS && isEnabled(k);
     }
 
     void setEnabled(const std::string& a, bool isEnabled_) override {
-        if (isEnabled_) enabled.insert(a);
-        else enabled.erase(a);
+        const size_t k = kernelIndex(a);
+        if (k == KERNELS) return;
+        if (isEnabled_) enabled |= uint64_t(1) << k;
+        else enabled &= ~(uint64_t(1) << k);
     }
 
     const std::vector<std::string> getAlgorithms() const override {
-        return {"averaging", "luma", "sobel", "sobel_v2", "blur", "desaturation", "de_composition_max", "de_composition_min"};
+        std::vector<std::string> names;
+        for (const auto& kr : kernels()) names.push_back(kr.name);
+        return names;
     }
 
    protected:
-    std::unordered_set<std::string> enabled;
+    uint64_t enabled = 0; // Bit k: kernels()[k] habilitado; nenhum bit habilita todos
 };
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ImagingAlgorithms.hpp"
+
+/**
+ * Registro das implementações avaliadas pelo benchmark: cada PixelOrder de `AllOrders` em Pointers e MemBlock de
+ * 8 bits e, para medir o custo de banda de cada layout, em MemBlock com os pixels mais largos. Um novo layout entra
+ * apenas em AllOrders (e nas instanciações de Image3D.cpp).
+ */
+template<PixelOrder... orders>
+struct OrderList {
+    template<bool memblock, typename T>
+    static void add(std::vector<ImagingAlgorithmsBase*>& out) {
+        (out.push_back(new ImagingAlgorithms<Image3D<orders, memblock, T>>()), ...);
+    }
+};
+
+typedef OrderList<PixelOrder::XYC, PixelOrder::XCY, PixelOrder::YXC, PixelOrder::YCX, PixelOrder::CXY, PixelOrder::CYX,
+                  PixelOrder::TILE8, PixelOrder::MORTON> AllOrders;
+
+/**
+ * Cria uma instância de cada implementação; o chamador é dono dos ponteiros.
+ */
+inline std::vector<ImagingAlgorithmsBase*> make_implementations() {
+    std::vector<ImagingAlgorithmsBase*> out;
+    AllOrders::add<false, uint8_t>(out);
+    AllOrders::add<true, uint8_t>(out);
+    AllOrders::add<true, uint16_t>(out);
+    AllOrders::add<true, float>(out);
+    return out;
+}
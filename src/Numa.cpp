@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Numa.hpp"
+#include "TaskScheduler.hpp"
+
+bool Numa::first_touch = false;
+uint Numa::fake_nodes = 0;
+
+namespace {
+std::mutex mutex;
+std::unordered_map<uintptr_t, uint> fake_pages; // Página -> nó simulado
+
+size_t page_size() {
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+/**
+ * Interpreta as listas de /sys ("0-3,8-11"); vazia se o arquivo não existir.
+ */
+std::vector<uint> read_list(const std::string& path) {
+    std::ifstream in(path);
+    std::vector<uint> values;
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        uint a, b;
+        const char *s = item.c_str();
+        if (std::sscanf(s, "%u-%u", &a, &b) == 2) {
+            for (uint v = a; v <= b; v++) values.push_back(v);
+        } else if (std::sscanf(s, "%u", &a) == 1) {
+            values.push_back(a);
+        }
+    }
+    return values;
+}
+
+std::vector<uint> online_nodes() {
+    const auto nodes = read_list("/sys/devices/system/node/online");
+    return nodes.empty() ? std::vector<uint>{0} : nodes;
+}
+
+uint fake_node(uint thread) {
+    return thread*Numa::fake_nodes/std::max(1u, parallel::threads()) % Numa::fake_nodes;
+}
+
+/**
+ * Registra no modo simulado o nó das páginas cujo primeiro byte do buffer está em [begin, end).
+ */
+void record(uintptr_t begin, uintptr_t end, uintptr_t buffer, uint node) {
+    const size_t ps = page_size();
+    uintptr_t pg = begin == buffer ? begin/ps*ps : (begin + ps - 1)/ps*ps;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (; pg < end; pg += ps) fake_pages[pg] = node;
+}
+}  // namespace
+
+uint Numa::nodes() {
+    return fake_nodes ? fake_nodes : online_nodes().back() + 1;
+}
+
+const std::vector<uint>& Numa::cpus() {
+    static const std::vector<uint> list = [] {
+        std::vector<uint> all;
+        for (const uint n : online_nodes()) {
+            for (const uint c : read_list("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist")) all.push_back(c);
+        }
+        if (all.empty()) {
+            for (uint c = 0; c < std::max(1u, std::thread::hardware_concurrency()); c++) all.push_back(c);
+        }
+        return all;
+    }();
+    return list;
+}
+
+void Numa::place(void *p, size_t bytes, size_t lines) {
+    if ((!first_touch && !fake_nodes) || bytes == 0 || lines == 0) return;
+    const uintptr_t base = reinterpret_cast<uintptr_t>(p);
+    if (!first_touch) {
+        // A thread que aloca é também a que escreve a imagem a seguir
+        record(base, base + bytes, base, fake_node(parallel::thread_index()));
+        return;
+    }
+    // Blocos de linhas; com menos linhas que threads (os planos de CXY e CYX), blocos de páginas
+    const size_t t = parallel::threads();
+    const size_t unit = lines >= t ? bytes/lines : page_size(), units = lines >= t ? lines : (bytes + unit - 1)/unit;
+    parallel::for_each_thread([&](long i) {
+        const size_t a = std::min(bytes, units*i/t*unit), b = i + 1 == long(t) ? bytes : std::min(bytes, units*(i + 1)/t*unit);
+        std::memset(static_cast<char*>(p) + a, 0, b - a);
+        if (fake_nodes) record(base + a, base + b, base, fake_node(i));
+    });
+}
+
+std::vector<size_t> Numa::pages(const void *p, size_t bytes) {
+    const size_t ps = page_size();
+    const uintptr_t first = reinterpret_cast<uintptr_t>(p)/ps*ps, end = reinterpret_cast<uintptr_t>(p) + bytes;
+    std::vector<size_t> count(nodes(), 0);
+    if (fake_nodes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uintptr_t pg = first; pg < end; pg += ps) {
+            const auto it = fake_pages.find(pg);
+            if (it != fake_pages.end()) count[it->second]++;
+        }
+        return count;
+    }
+    // move_pages sem nós de destino apenas consulta o nó de cada página
+    constexpr size_t BATCH = 1024;
+    void *addrs[BATCH];
+    int status[BATCH];
+    for (uintptr_t pg = first; pg < end;) {
+        size_t n = 0;
+        for (; n < BATCH && pg < end; n++, pg += ps) addrs[n] = reinterpret_cast<void*>(pg);
+        if (syscall(SYS_move_pages, 0, n, addrs, nullptr, status, 0) != 0) return {};
+        for (size_t i = 0; i < n; i++) {
+            if (status[i] < 0) continue; // Não tocada
+            if (size_t(status[i]) >= count.size()) count.resize(status[i] + 1, 0);
+            count[status[i]]++;
+        }
+    }
+    return count;
+}
+
+std::string Numa::report(const void *p, size_t bytes) {
+    std::ostringstream ss;
+    const auto count = pages(p, bytes);
+    for (size_t n = 0; n < count.size(); n++) ss << (n ? "/" : "") << count[n];
+    return ss.str();
+}
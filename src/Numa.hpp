@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Posicionamento dos buffers de imagem nos nós NUMA.
+ * Por padrão, cada página fica no nó da thread que a toca primeiro, a que carrega a imagem. Com `first_touch`, os
+ * buffers MemBlock recém-alocados são zerados em paralelo: cada thread toca um bloco contíguo de linhas da primeira
+ * coordenada de memória, a mesma divisão em blocos que o escalonador dá às threads nos algoritmos. As escritas
+ * seguintes (decodificação, conversão) não mudam o nó das páginas.
+ * Com `fake_nodes` > 0, simula essa quantidade de nós em qualquer máquina: a thread de índice i fica no nó
+ * i*fake_nodes/threads (como com --pin), e o nó de cada página é registrado quando a alocação a posiciona.
+ */
+struct Numa {
+    static bool first_touch;
+    static uint fake_nodes;
+
+    /**
+     * Quantidade de nós (simulados, se fake_nodes > 0).
+     */
+    static uint nodes();
+
+    /**
+     * CPUs online, nó a nó: a ordem em que --pin distribui as threads.
+     */
+    static const std::vector<uint>& cpus();
+
+    /**
+     * Posiciona o buffer recém-alocado [p, p + bytes), formado por `lines` linhas da primeira coordenada.
+     */
+    static void place(void *p, size_t bytes, size_t lines);
+
+    /**
+     * Páginas de [p, p + bytes) em cada nó (move_pages, ou o registro do modo simulado); páginas ainda não tocadas
+     * não são contadas. Vazio se a consulta não for possível.
+     */
+    static std::vector<size_t> pages(const void *p, size_t bytes);
+
+    /**
+     * pages() formatado como "nó0/nó1/...", para os registros de resultado.
+     */
+    static std::string report(const void *p, size_t bytes);
+};
@@ -0,0 +1,70 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "PerfCounters.hpp"
+
+static int _perf_event_open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static constexpr uint64_t _hw_cache(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+PerfCounters::PerfCounters() {
+    const struct { const char *name; uint32_t type; uint64_t config; } events[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"l1d_misses", PERF_TYPE_HW_CACHE, _hw_cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"llc_misses", PERF_TYPE_HW_CACHE, _hw_cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"dtlb_misses", PERF_TYPE_HW_CACHE, _hw_cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    for (const auto& e : events) {
+        const int fd = _perf_event_open(e.type, e.config);
+        if (fd < 0) {
+            if (error.empty()) error = std::string(e.name) + ": " + std::strerror(errno);
+            continue;
+        }
+        counters.push_back({e.name, fd});
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const auto& c : counters) close(c.fd);
+}
+
+void PerfCounters::reset() {
+    for (const auto& c : counters) ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+}
+
+void PerfCounters::start() {
+    for (const auto& c : counters) ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void PerfCounters::stop() {
+    for (const auto& c : counters) ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+std::vector<std::pair<std::string, uint64_t>> PerfCounters::read() const {
+    std::vector<std::pair<std::string, uint64_t>> r;
+    for (const auto& c : counters) {
+        uint64_t v[3]; // value, time_enabled, time_running
+        if (::read(c.fd, v, sizeof(v)) != sizeof(v)) continue;
+        const double scale = v[2] ? double(v[1])/double(v[2]) : 0;
+        r.emplace_back(c.name, uint64_t(v[0]*scale));
+    }
+    return r;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Contadores de hardware via perf_event_open (Linux) em torno de uma região cronometrada.
+ * Conta apenas a thread que os abriu: na build PARALLELIZE, as threads do OpenMP não são incluídas.
+ * Eventos não suportados pela máquina (ou bloqueados por perf_event_paranoid) são omitidos.
+ */
+struct PerfCounters {
+    struct Counter {
+        std::string name;
+        int fd;
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return !counters.empty(); }
+    const std::string& getError() const { return error; }
+
+    void reset();
+    void start();
+    void stop();
+
+    /**
+     * Lê os valores acumulados desde o último reset(), corrigidos pela multiplexação do kernel.
+     */
+    std::vector<std::pair<std::string, uint64_t>> read() const;
+
+   protected:
+    std::vector<Counter> counters;
+    std::string error;
+};
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "Results.hpp"
+
+namespace results {
+
+static const char *const KEY_FIELDS[] = {"implementation", "algorithm", "width", "height", "threads", "scheduler",
+                                         "row_align", "traversal"};
+
+std::string key(const BenchRecord& r) {
+    std::string k;
+    for (const char *f : KEY_FIELDS) k += r.get(f) + "|";
+    return k;
+}
+
+/**
+ * Interpreta um objeto JSON plano (valores string ou numéricos), como os escritos por BenchWriter.
+ */
+static bool parse(const std::string& line, BenchRecord& r) {
+    size_t i = 0;
+    const auto ws = [&] { while (i < line.size() && std::isspace((unsigned char)line[i])) i++; };
+    const auto str = [&](std::string& out) {
+        if (line[i] != '"') return false;
+        for (i++; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\') i++;
+            if (i < line.size()) out += line[i];
+        }
+        return i++ < line.size();
+    };
+    ws();
+    if (i >= line.size() || line[i++] != '{') return false;
+    while (true) {
+        ws();
+        if (i < line.size() && line[i] == '}') return true;
+        BenchRecord::Field f;
+        if (i >= line.size() || !str(f.key)) return false;
+        ws();
+        if (i >= line.size() || line[i++] != ':') return false;
+        ws();
+        if (i >= line.size()) return false;
+        if (line[i] == '"') {
+            if (!str(f.value)) return false;
+            f.numeric = false;
+        } else {
+            const size_t end = line.find_first_of(",}", i);
+            if (end == std::string::npos) return false;
+            f.value = line.substr(i, end - i);
+            while (!f.value.empty() && std::isspace((unsigned char)f.value.back())) f.value.pop_back();
+            f.numeric = true;
+            i = end;
+        }
+        r.fields.push_back(std::move(f));
+        ws();
+        if (i < line.size() && line[i] == ',') i++;
+    }
+}
+
+std::vector<BenchRecord> load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::vector<BenchRecord> records;
+    for (std::string line; std::getline(in, line);) {
+        BenchRecord r;
+        if (parse(line, r)) records.push_back(std::move(r));
+    }
+    return records;
+}
+
+std::string join(const std::vector<int64_t>& samples) {
+    std::ostringstream ss;
+    for (size_t i = 0; i < samples.size(); i++) ss << (i ? ";" : "") << samples[i];
+    return ss.str();
+}
+
+std::vector<int64_t> samples(const BenchRecord& r) {
+    std::vector<int64_t> s;
+    std::istringstream in(r.get("samples"));
+    for (std::string v; std::getline(in, v, ';');) {
+        if (!v.empty()) s.push_back(std::stoll(v));
+    }
+    return s;
+}
+
+double mann_whitney(const std::vector<int64_t>& a, const std::vector<int64_t>& b) {
+    const double n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    if (a.empty() || b.empty()) return 1;
+    // Postos da amostra conjunta, com a média dos postos nos empates
+    std::vector<std::pair<int64_t, bool>> all;
+    for (const auto v : a) all.emplace_back(v, true);
+    for (const auto v : b) all.emplace_back(v, false);
+    std::sort(all.begin(), all.end());
+    double rank_a = 0, ties = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) j++;
+        const double t = j - i, rank = (i + 1 + j)/2.0;
+        for (size_t k = i; k < j; k++) if (all[k].second) rank_a += rank;
+        ties += t*t*t - t;
+        i = j;
+    }
+    const double u = rank_a - n1*(n1 + 1)/2, mean = n1*n2/2;
+    const double var = n1*n2/12*((n + 1) - ties/(n*(n - 1)));
+    if (var <= 0) return 1;
+    const double z = std::max(0.0, std::abs(u - mean) - 0.5)/std::sqrt(var);
+    return std::erfc(z/std::sqrt(2));
+}
+
+/**
+ * Reúne os registros por chave, na ordem da primeira ocorrência, juntando as amostras.
+ */
+static std::vector<std::pair<BenchRecord, std::vector<int64_t>>> group(const std::vector<BenchRecord>& records) {
+    std::vector<std::pair<BenchRecord, std::vector<int64_t>>> groups;
+    std::map<std::string, size_t> index;
+    for (const auto& r : records) {
+        const auto s = samples(r);
+        if (s.empty()) continue;
+        const auto it = index.emplace(key(r), groups.size()).first;
+        if (it->second == groups.size()) groups.emplace_back(r, std::vector<int64_t>());
+        auto& all = groups[it->second].second;
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    return groups;
+}
+
+static double median(std::vector<int64_t> s) {
+    std::sort(s.begin(), s.end());
+    const size_t n = s.size();
+    return n % 2 ? s[n/2] : (s[n/2 - 1] + s[n/2])/2.0;
+}
+
+std::vector<BenchRecord> compare(const std::vector<BenchRecord>& baseline, const std::vector<BenchRecord>& current,
+                                 double alpha, double threshold, Summary& summary) {
+    const auto base = group(baseline);
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < base.size(); i++) index.emplace(key(base[i].first), i);
+
+    std::vector<BenchRecord> out;
+    for (const auto& c : group(current)) {
+        const BenchRecord& r = c.first;
+        BenchRecord rec;
+        for (const char *f : KEY_FIELDS) {
+            if (!r.get(f).empty()) rec.set(f, r.get(f));
+        }
+        const double m = median(c.second);
+        const auto it = index.find(key(r));
+        if (it == index.end()) {
+            rec.set("baseline_commit", "").set("baseline_median", 0.0).set("median", m).set("change_pct", 0.0)
+               .set("p_value", 1.0).set("verdict", "no-baseline");
+            summary.missing++;
+        } else {
+            const auto& b = base[it->second];
+            const double bm = median(b.second), change = bm > 0 ? (m - bm)/bm : 0;
+            const double p = mann_whitney(b.second, c.second);
+            const bool significant = p < alpha && std::abs(change) > threshold;
+            const char *verdict = !significant ? "unchanged" : change > 0 ? "regression" : "improvement";
+            rec.set("baseline_commit", b.first.get("commit")).set("baseline_median", bm).set("median", m)
+               .set("change_pct", 100*change).set("p_value", p).set("verdict", verdict);
+            if (!significant) summary.unchanged++;
+            else if (change > 0) summary.regressions++;
+            else summary.improvements++;
+        }
+        out.push_back(std::move(rec));
+    }
+    return out;
+}
+
+}  // namespace results
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "benchmark.hpp"
+
+/**
+ * Arquivo estruturado de resultados (--results): uma linha JSON por medida do modo por algoritmo, com o commit e as
+ * amostras das repetições ("samples", separadas por ';'). Cada medida é identificada por key(): implementação,
+ * algoritmo, tamanho da imagem, threads e as variações da execução (escalonador, row_align, traversal); medidas
+ * com a mesma chave (imagens do mesmo tamanho) têm suas amostras reunidas.
+ * A comparação (--compare) casa as medidas atuais com as de um arquivo de referência pela chave e aplica o teste
+ * de Mann-Whitney às amostras: uma diferença é significativa com p < alpha e variação da mediana acima de
+ * `threshold` (fração da mediana de referência).
+ */
+namespace results {
+
+std::string key(const BenchRecord& r);
+
+/**
+ * Lê os registros de um arquivo escrito por BenchWriter em JSON; lança std::runtime_error se não puder abri-lo.
+ */
+std::vector<BenchRecord> load(const std::string& path);
+
+std::string join(const std::vector<int64_t>& samples);
+std::vector<int64_t> samples(const BenchRecord& r);
+
+/**
+ * p-valor bilateral do teste U de Mann-Whitney, pela aproximação normal com correção de empates e de continuidade.
+ * Com 5 repetições de cada lado, o menor p possível é cerca de 0,01.
+ */
+double mann_whitney(const std::vector<int64_t>& a, const std::vector<int64_t>& b);
+
+struct Summary {
+    uint regressions = 0, improvements = 0, unchanged = 0, missing = 0;
+};
+
+/**
+ * Compara `current` com `baseline`: um registro por chave atual, com as medianas, a variação, o p-valor e o
+ * veredito ("regression", "improvement", "unchanged" ou "no-baseline").
+ */
+std::vector<BenchRecord> compare(const std::vector<BenchRecord>& baseline, const std::vector<BenchRecord>& current,
+                                 double alpha, double threshold, Summary& summary);
+
+}  // namespace results
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "Roofline.hpp"
+#include "BufferPool.hpp"
+#include "SimdKernels.hpp"
+#include "TaskScheduler.hpp"
+
+namespace {
+constexpr uint REPETITIONS = 5;
+constexpr uint64_t INT_ITERATIONS = uint64_t(1) << 22;
+
+/**
+ * Melhor tempo (em segundos) entre REPETITIONS execuções de run(i0, i1) sobre [0, n), inteiro na thread atual ou
+ * dividido em blocos contíguos, um por thread.
+ */
+template<typename Run>
+double best(size_t n, bool all_threads, Run run) {
+    double t = std::numeric_limits<double>::max();
+    for (uint r = 0; r < REPETITIONS; r++) {
+        BenchClock clock;
+        if (all_threads) {
+            const size_t k = parallel::threads();
+            parallel::for_each_thread([&](long i) { run(n*i/k, n*(i + 1)/k); });
+        } else {
+            run(0, n);
+        }
+        t = std::min(t, BenchClock::toSeconds(clock.getElapsed()));
+    }
+    return std::max(t, 1e-9);
+}
+
+Roofline::Peaks measure(uint64_t *a, uint64_t *b, size_t n, bool all_threads) {
+    Roofline::Peaks p;
+    const double bytes = double(n)*sizeof(uint64_t);
+    p.read = bytes/best(n, all_threads, [&](size_t i0, size_t i1) {
+        uint64_t s = 0;
+        for (size_t i = i0; i < i1; i++) s += a[i];
+        asm volatile("" : : "r"(s)); // Mantém a soma viva sem escrever na memória
+    })/1e9;
+    p.write = bytes/best(n, all_threads, [&](size_t i0, size_t i1) { std::fill(b + i0, b + i1, i1); })/1e9;
+    p.copy = 2*bytes/best(n, all_threads, [&](size_t i0, size_t i1) {
+        std::memcpy(b + i0, a + i0, (i1 - i0)*sizeof(uint64_t));
+    })/1e9;
+
+    // Uma unidade de trabalho por thread: n = threads
+    const size_t k = all_threads ? parallel::threads() : 1;
+    for (const bool scalar : {true, false}) {
+        std::atomic<uint64_t> per_unit(0); // Igual em todas as unidades
+        const double t = best(k, all_threads, [&](size_t i0, size_t i1) {
+            for (size_t i = i0; i < i1; i++) per_unit = simd::int_add_throughput(INT_ITERATIONS, scalar);
+        });
+        (scalar ? p.scalar_gops : p.simd_gops) = double(per_unit)*k/t/1e9;
+    }
+    return p;
+}
+}  // namespace
+
+Roofline Roofline::calibrate(size_t bytes) {
+    Roofline r;
+    const size_t n = std::max<size_t>(bytes/sizeof(uint64_t), 1);
+    uint64_t *a = static_cast<uint64_t*>(BufferPool::acquire(n*sizeof(uint64_t), 64));
+    uint64_t *b = static_cast<uint64_t*>(BufferPool::acquire(n*sizeof(uint64_t), 64));
+    // Primeiro toque com a mesma divisão das medidas com todas as threads
+    const size_t k = parallel::threads();
+    parallel::for_each_thread([&](long i) {
+        for (size_t j = n*i/k; j < n*(i + 1)/k; j++) a[j] = b[j] = j;
+    });
+    r.threads = parallel::threads();
+    r.single = measure(a, b, n, false);
+    r.multi = r.threads > 1 ? measure(a, b, n, true) : r.single;
+    BufferPool::release(a);
+    BufferPool::release(b);
+    return r;
+}
+
+void Roofline::print(std::ostream& out) const {
+    const auto line = [&](const Peaks& p, uint t) {
+        out << "# Roofline with " << t << " thread(s): read " << p.read << " GB/s, write " << p.write << " GB/s, copy "
+            << p.copy << " GB/s, scalar " << p.scalar_gops << " Gops/s, SIMD (" << simd::isa() << ") " << p.simd_gops << " Gops/s\n";
+    };
+    line(single, 1);
+    if (threads > 1) line(multi, threads);
+}
+
+void Roofline::annotate(BenchRecord& rec, double bytes, double ops, double seconds, uint used_threads) const {
+    const Peaks& p = used_threads > 1 ? multi : single;
+    const double memory = bytes/(p.copy*1e9), compute = ops/(p.simd_gops*1e9);
+    rec.set("bytes", bytes).set("ops", ops)
+       .set("roofline_bound", memory >= compute ? "memory" : "compute")
+       .set("roofline_gb_per_s", p.copy)
+       .set("roofline_pct", seconds > 0 ? 100*std::max(memory, compute)/seconds : 0.0);
+}
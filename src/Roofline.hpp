@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include "benchmark.hpp"
+
+/**
+ * Limites da máquina medidos antes do benchmark, no estilo do STREAM: vazão sustentada de leitura, escrita e cópia
+ * sobre vetores maiores que a cache, e vazão máxima de somas inteiras escalares e SIMD (simd::int_add_throughput),
+ * com uma thread e com parallel::threads() threads. Cada medida é a melhor de algumas repetições.
+ * annotate() compara um resultado com o roofline: o tempo mínimo possível é o maior entre bytes/banda de cópia
+ * (leitura e escrita, como nos algoritmos) e operações/vazão SIMD.
+ */
+struct Roofline {
+    struct Peaks {
+        double read = 0, write = 0, copy = 0; // GB/s; a cópia conta os bytes lidos e os escritos
+        double scalar_gops = 0, simd_gops = 0; // Giga-somas inteiras por segundo
+    };
+    Peaks single, multi;
+    uint threads = 1;
+
+    /**
+     * Mede os limites com vetores de `bytes` bytes cada (origem e destino).
+     */
+    static Roofline calibrate(size_t bytes);
+
+    void print(std::ostream& out) const;
+
+    /**
+     * Acrescenta a rec os bytes movidos e as operações inteiras de uma execução de `seconds` segundos, o limite
+     * aplicável (memória ou computação) e a porcentagem do roofline atingida. Usa os limites de uma thread se a
+     * execução usou apenas uma. Acima de 100%, os dados couberam na cache, mais rápida que a banda calibrada.
+     */
+    void annotate(BenchRecord& rec, double bytes, double ops, double seconds, uint used_threads) const;
+};
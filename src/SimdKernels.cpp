@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#include "SimdKernels.hpp"
+
+namespace simd {
+
+//
+// Versões escalares
+//
+
+static void gray_planar_scalar(GrayOp op, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                               uint8_t *dr, uint8_t *dg, uint8_t *db, size_t i, size_t n) {
+    for (; i < n; i++) dr[i] = dg[i] = db[i] = gray_scalar(op, r[i], g[i], b[i]);
+}
+
+static void gray_interleaved_scalar(GrayOp op, const uint8_t *src, uint8_t *dst, size_t i, size_t n) {
+    for (; i < n; i++) dst[3*i] = dst[3*i + 1] = dst[3*i + 2] = gray_scalar(op, src[3*i], src[3*i + 1], src[3*i + 2]);
+}
+
+static void deinterleave_rgb_scalar(const uint8_t *src, uint8_t *r, uint8_t *g, uint8_t *b, size_t i, size_t n) {
+    for (; i < n; i++) {
+        r[i] = src[3*i];
+        g[i] = src[3*i + 1];
+        b[i] = src[3*i + 2];
+    }
+}
+
+static void interleave_rgb_scalar(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, size_t i, size_t n) {
+    for (; i < n; i++) {
+        dst[3*i] = r[i];
+        dst[3*i + 1] = g[i];
+        dst[3*i + 2] = b[i];
+    }
+}
+
+static void sobel_run_scalar(const uint8_t *p, ptrdiff_t sx, ptrdiff_t sy, uint8_t *dst, size_t i, size_t n, const uint8_t *lut) {
+    for (; i < n; i++) {
+        const uint8_t *q = p + i;
+        const int hor = int(q[-sx-sy] + 2*q[-sy] + q[sx-sy]) - int(q[-sx+sy] + 2*q[sy] + q[sx+sy]);
+        const int ver = int(q[-sx-sy] + 2*q[-sx] + q[-sx+sy]) - int(q[sx-sy] + 2*q[sx] + q[sx+sy]);
+        dst[i] = lut[(hor*hor + ver*ver) >> SOBEL_LUT_SHIFT];
+    }
+}
+
+static void lut_apply_scalar(const uint8_t *lut, const uint8_t *src, uint8_t *dst, size_t i, size_t n, uint channels) {
+    for (uint c = i % channels; i < n; i++) {
+        dst[i] = lut[c*256 + src[i]];
+        if (++c == channels) c = 0;
+    }
+}
+
+//
+// Tabela de Sobel: cada posição cobre 2^SOBEL_LUT_SHIFT valores de g², cujas saídas exatas variam menos de 2 nesse
+// intervalo; guardamos o ponto médio entre a menor e a maior, a no máximo ±1 de todas elas.
+//
+
+struct SobelLut {
+    static constexpr int G2_MAX = 2*1020*1020;                  // |hor|, |ver| <= 4*255
+    static constexpr int SIZE = (G2_MAX >> SOBEL_LUT_SHIFT) + 1;
+    uint8_t v[SIZE + 3];                                          // +3: o gather AVX2 lê 4 bytes por índice
+
+    SobelLut() {
+        // Mesma normalização de sobel: a matriz [[255 255 255] [255 0 0] [0 0 0]] resulta em 255
+        const double maxdiv = std::sqrt(1020.0*1020.0 + 510.0*510.0);
+        const auto exact = [&](int g2) { return std::min(255, int(255*(std::sqrt(double(g2))/maxdiv))); };
+        for (int i = 0; i < SIZE; i++) {
+            const int lo = exact(i << SOBEL_LUT_SHIFT), hi = exact(((i + 1) << SOBEL_LUT_SHIFT) - 1);
+            v[i] = (lo + hi + 1)/2;
+        }
+        std::fill(v + SIZE, v + SIZE + 3, 0);
+    }
+};
+
+const uint8_t *sobel_lut() {
+    static const SobelLut table;
+    return table.v;
+}
+
+//
+// Máscaras de pshufb para (des)intercalar 16 pixels RGB (48 bytes, em três vetores de 16)
+//
+
+struct alignas(16) ShuffleMasks {
+    uint8_t deinterleave[3][3][16]; // [canal][vetor de origem][byte]
+    uint8_t interleave[3][16];      // [vetor de destino][byte]
+    uint8_t planes[3][3][16];       // [vetor de destino][canal][byte], de três planos para RGB
+
+    ShuffleMasks() {
+        for (int ch = 0; ch < 3; ch++)
+            for (int s = 0; s < 3; s++)
+                for (int k = 0; k < 16; k++) {
+                    const int idx = 3*k + ch;
+                    deinterleave[ch][s][k] = idx/16 == s ? idx%16 : 0x80;
+                }
+        for (int s = 0; s < 3; s++)
+            for (int k = 0; k < 16; k++) interleave[s][k] = (16*s + k)/3;
+        for (int s = 0; s < 3; s++)
+            for (int ch = 0; ch < 3; ch++)
+                for (int k = 0; k < 16; k++) {
+                    const int idx = 16*s + k;
+                    planes[s][ch][k] = idx%3 == ch ? idx/3 : 0x80;
+                }
+    }
+};
+static const ShuffleMasks masks;
+
+//
+// Núcleo comum: calcula o cinza a partir dos vetores r, g, b de bytes.
+// V é __m128i ou __m256i e B o sufixo das operações de bits (si128 ou si256).
+//
+
+#define SIMD_GRAY_BODY(P, V, B)                                                                   \
+    switch (op) {                                                                                \
+        case GrayOp::DE_COMPOSITION_MAX: return P##_max_epu8(P##_max_epu8(r, g), b);             \
+        case GrayOp::DE_COMPOSITION_MIN: return P##_min_epu8(P##_min_epu8(r, g), b);             \
+        case GrayOp::DESATURATION: {                                                             \
+            const V mx = P##_max_epu8(P##_max_epu8(r, g), b), mn = P##_min_epu8(P##_min_epu8(r, g), b); \
+            /* avg_epu8 arredonda para cima; subtrai o bit perdido para obter floor((mx+mn)/2) */ \
+            return P##_sub_epi8(P##_avg_epu8(mx, mn), P##_and_##B(P##_xor_##B(mx, mn), P##_set1_epi8(1))); \
+        }                                                                                        \
+        default: break;                                                                          \
+    }                                                                                            \
+    const V z = P##_setzero_##B();                                                      \
+    V lo, hi;                                                                                    \
+    if (op == GrayOp::AVERAGING) {                                                               \
+        /* (r+g+b)/3 == ((r+g+b)*21846) >> 16 para r+g+b <= 765 */                                 \
+        const V m = P##_set1_epi16(21846);                                                       \
+        lo = P##_mulhi_epu16(P##_add_epi16(P##_add_epi16(P##_unpacklo_epi8(r, z), P##_unpacklo_epi8(g, z)), P##_unpacklo_epi8(b, z)), m); \
+        hi = P##_mulhi_epu16(P##_add_epi16(P##_add_epi16(P##_unpackhi_epi8(r, z), P##_unpackhi_epi8(g, z)), P##_unpackhi_epi8(b, z)), m); \
+    } else {                                                                                     \
+        /* Luma em ponto fixo: n/100 == ((n*5243) >> 16) >> 3 para n <= 25500 */                 \
+        const V wr = P##_set1_epi16(30), wg = P##_set1_epi16(59), wb = P##_set1_epi16(11), m = P##_set1_epi16(5243); \
+        lo = P##_add_epi16(P##_add_epi16(P##_mullo_epi16(P##_unpacklo_epi8(r, z), wr), P##_mullo_epi16(P##_unpacklo_epi8(g, z), wg)), P##_mullo_epi16(P##_unpacklo_epi8(b, z), wb)); \
+        hi = P##_add_epi16(P##_add_epi16(P##_mullo_epi16(P##_unpackhi_epi8(r, z), wr), P##_mullo_epi16(P##_unpackhi_epi8(g, z), wg)), P##_mullo_epi16(P##_unpackhi_epi8(b, z), wb)); \
+        lo = P##_srli_epi16(P##_mulhi_epu16(lo, m), 3);                                          \
+        hi = P##_srli_epi16(P##_mulhi_epu16(hi, m), 3);                                          \
+    }                                                                                            \
+    return P##_packus_epi16(lo, hi);
+
+__attribute__((target("sse4.1")))
+static inline __m128i gray_sse(GrayOp op, __m128i r, __m128i g, __m128i b) {
+    SIMD_GRAY_BODY(_mm, __m128i, si128)
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gray_avx2(GrayOp op, __m256i r, __m256i g, __m256i b) {
+    SIMD_GRAY_BODY(_mm256, __m256i, si256)
+}
+
+//
+// SSE4.1
+//
+
+__attribute__((target("sse4.1")))
+static void gray_planar_sse(GrayOp op, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                            uint8_t *dr, uint8_t *dg, uint8_t *db, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = gray_sse(op, _mm_loadu_si128((const __m128i*)(r + i)), _mm_loadu_si128((const __m128i*)(g + i)),
+                                   _mm_loadu_si128((const __m128i*)(b + i)));
+        _mm_storeu_si128((__m128i*)(dr + i), v);
+        _mm_storeu_si128((__m128i*)(dg + i), v);
+        _mm_storeu_si128((__m128i*)(db + i), v);
+    }
+    gray_planar_scalar(op, r, g, b, dr, dg, db, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static inline void deinterleave_sse(const __m128i v[3], __m128i rgb[3]) {
+    for (int ch = 0; ch < 3; ch++) {
+        rgb[ch] = _mm_or_si128(_mm_or_si128(
+                    _mm_shuffle_epi8(v[0], _mm_load_si128((const __m128i*)masks.deinterleave[ch][0])),
+                    _mm_shuffle_epi8(v[1], _mm_load_si128((const __m128i*)masks.deinterleave[ch][1]))),
+                    _mm_shuffle_epi8(v[2], _mm_load_si128((const __m128i*)masks.deinterleave[ch][2])));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void gray_interleaved_sse(GrayOp op, const uint8_t *src, uint8_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v[3] = {_mm_loadu_si128((const __m128i*)(src + 3*i)), _mm_loadu_si128((const __m128i*)(src + 3*i + 16)),
+                              _mm_loadu_si128((const __m128i*)(src + 3*i + 32))};
+        __m128i rgb[3];
+        deinterleave_sse(v, rgb);
+        const __m128i gray = gray_sse(op, rgb[0], rgb[1], rgb[2]);
+        for (int s = 0; s < 3; s++)
+            _mm_storeu_si128((__m128i*)(dst + 3*i + 16*s), _mm_shuffle_epi8(gray, _mm_load_si128((const __m128i*)masks.interleave[s])));
+    }
+    gray_interleaved_scalar(op, src, dst, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static void deinterleave_rgb_sse(const uint8_t *src, uint8_t *r, uint8_t *g, uint8_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v[3] = {_mm_loadu_si128((const __m128i*)(src + 3*i)), _mm_loadu_si128((const __m128i*)(src + 3*i + 16)),
+                              _mm_loadu_si128((const __m128i*)(src + 3*i + 32))};
+        __m128i rgb[3];
+        deinterleave_sse(v, rgb);
+        _mm_storeu_si128((__m128i*)(r + i), rgb[0]);
+        _mm_storeu_si128((__m128i*)(g + i), rgb[1]);
+        _mm_storeu_si128((__m128i*)(b + i), rgb[2]);
+    }
+    deinterleave_rgb_scalar(src, r, g, b, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static void interleave_rgb_sse(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i rgb[3] = {_mm_loadu_si128((const __m128i*)(r + i)), _mm_loadu_si128((const __m128i*)(g + i)),
+                                _mm_loadu_si128((const __m128i*)(b + i))};
+        for (int s = 0; s < 3; s++)
+            _mm_storeu_si128((__m128i*)(dst + 3*i + 16*s), _mm_or_si128(_mm_or_si128(
+                    _mm_shuffle_epi8(rgb[0], _mm_load_si128((const __m128i*)masks.planes[s][0])),
+                    _mm_shuffle_epi8(rgb[1], _mm_load_si128((const __m128i*)masks.planes[s][1]))),
+                    _mm_shuffle_epi8(rgb[2], _mm_load_si128((const __m128i*)masks.planes[s][2]))));
+    }
+    interleave_rgb_scalar(r, g, b, dst, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i widen_sse(const uint8_t *p) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)p));
+}
+
+__attribute__((target("sse4.1")))
+static void sobel_run_sse(const uint8_t *p, ptrdiff_t sx, ptrdiff_t sy, uint8_t *dst, size_t n) {
+    const uint8_t *lut = sobel_lut();
+    alignas(16) uint32_t idx[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const uint8_t *q = p + i;
+        const __m128i a = widen_sse(q - sx - sy), b = widen_sse(q - sy), c = widen_sse(q + sx - sy), d = widen_sse(q - sx),
+                      e = widen_sse(q + sx), f = widen_sse(q - sx + sy), g = widen_sse(q + sy), h = widen_sse(q + sx + sy);
+        const __m128i hor = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a, c), _mm_slli_epi16(b, 1)), _mm_add_epi16(_mm_add_epi16(f, h), _mm_slli_epi16(g, 1)));
+        const __m128i ver = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a, f), _mm_slli_epi16(d, 1)), _mm_add_epi16(_mm_add_epi16(c, h), _mm_slli_epi16(e, 1)));
+        // (hor, ver) intercalados: madd soma hor² + ver² em 32 bits
+        const __m128i lo = _mm_unpacklo_epi16(hor, ver), hi = _mm_unpackhi_epi16(hor, ver);
+        _mm_store_si128((__m128i*)idx, _mm_srli_epi32(_mm_madd_epi16(lo, lo), SOBEL_LUT_SHIFT));
+        _mm_store_si128((__m128i*)(idx + 4), _mm_srli_epi32(_mm_madd_epi16(hi, hi), SOBEL_LUT_SHIFT));
+        for (int k = 0; k < 8; k++) dst[i + k] = lut[idx[k]];
+    }
+    sobel_run_scalar(p, sx, sy, dst, i, n, lut);
+}
+
+//
+// AVX2: como pshufb opera por lane de 128 bits, o caso intercalado processa dois blocos
+// independentes de 16 pixels, um em cada lane.
+//
+
+__attribute__((target("avx2")))
+static void gray_planar_avx2(GrayOp op, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                             uint8_t *dr, uint8_t *dg, uint8_t *db, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v = gray_avx2(op, _mm256_loadu_si256((const __m256i*)(r + i)), _mm256_loadu_si256((const __m256i*)(g + i)),
+                                    _mm256_loadu_si256((const __m256i*)(b + i)));
+        _mm256_storeu_si256((__m256i*)(dr + i), v);
+        _mm256_storeu_si256((__m256i*)(dg + i), v);
+        _mm256_storeu_si256((__m256i*)(db + i), v);
+    }
+    gray_planar_scalar(op, r, g, b, dr, dg, db, i, n);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load2x128(const uint8_t *lo, const uint8_t *hi) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)lo)), _mm_loadu_si128((const __m128i*)hi), 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mask2x128(const uint8_t *m) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m));
+}
+
+__attribute__((target("avx2")))
+static void gray_interleaved_avx2(GrayOp op, const uint8_t *src, uint8_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const uint8_t *s0 = src + 3*i, *s1 = s0 + 48;
+        const __m256i v[3] = {load2x128(s0, s1), load2x128(s0 + 16, s1 + 16), load2x128(s0 + 32, s1 + 32)};
+        __m256i rgb[3];
+        for (int ch = 0; ch < 3; ch++) {
+            rgb[ch] = _mm256_or_si256(_mm256_or_si256(
+                        _mm256_shuffle_epi8(v[0], mask2x128(masks.deinterleave[ch][0])),
+                        _mm256_shuffle_epi8(v[1], mask2x128(masks.deinterleave[ch][1]))),
+                        _mm256_shuffle_epi8(v[2], mask2x128(masks.deinterleave[ch][2])));
+        }
+        const __m256i gray = gray_avx2(op, rgb[0], rgb[1], rgb[2]);
+        uint8_t *d0 = dst + 3*i, *d1 = d0 + 48;
+        for (int s = 0; s < 3; s++) {
+            const __m256i o = _mm256_shuffle_epi8(gray, mask2x128(masks.interleave[s]));
+            _mm_storeu_si128((__m128i*)(d0 + 16*s), _mm256_castsi256_si128(o));
+            _mm_storeu_si128((__m128i*)(d1 + 16*s), _mm256_extracti128_si256(o, 1));
+        }
+    }
+    gray_interleaved_scalar(op, src, dst, i, n);
+}
+
+__attribute__((target("avx2")))
+static void deinterleave_rgb_avx2(const uint8_t *src, uint8_t *r, uint8_t *g, uint8_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const uint8_t *s0 = src + 3*i, *s1 = s0 + 48;
+        const __m256i v[3] = {load2x128(s0, s1), load2x128(s0 + 16, s1 + 16), load2x128(s0 + 32, s1 + 32)};
+        uint8_t *out[3] = {r + i, g + i, b + i};
+        for (int ch = 0; ch < 3; ch++) {
+            // a lane baixa contém os pixels i..i+15 e a alta i+16..i+31, então o vetor já está em ordem
+            _mm256_storeu_si256((__m256i*)out[ch], _mm256_or_si256(_mm256_or_si256(
+                    _mm256_shuffle_epi8(v[0], mask2x128(masks.deinterleave[ch][0])),
+                    _mm256_shuffle_epi8(v[1], mask2x128(masks.deinterleave[ch][1]))),
+                    _mm256_shuffle_epi8(v[2], mask2x128(masks.deinterleave[ch][2]))));
+        }
+    }
+    deinterleave_rgb_scalar(src, r, g, b, i, n);
+}
+
+__attribute__((target("avx2")))
+static void interleave_rgb_avx2(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i rgb[3] = {_mm256_loadu_si256((const __m256i*)(r + i)), _mm256_loadu_si256((const __m256i*)(g + i)),
+                                _mm256_loadu_si256((const __m256i*)(b + i))};
+        uint8_t *d0 = dst + 3*i, *d1 = d0 + 48;
+        for (int s = 0; s < 3; s++) {
+            const __m256i o = _mm256_or_si256(_mm256_or_si256(
+                    _mm256_shuffle_epi8(rgb[0], mask2x128(masks.planes[s][0])),
+                    _mm256_shuffle_epi8(rgb[1], mask2x128(masks.planes[s][1]))),
+                    _mm256_shuffle_epi8(rgb[2], mask2x128(masks.planes[s][2])));
+            _mm_storeu_si128((__m128i*)(d0 + 16*s), _mm256_castsi256_si128(o));
+            _mm_storeu_si128((__m128i*)(d1 + 16*s), _mm256_extracti128_si256(o, 1));
+        }
+    }
+    interleave_rgb_scalar(r, g, b, dst, i, n);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i widen_avx2(const uint8_t *p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+__attribute__((target("avx2")))
+static void sobel_run_avx2(const uint8_t *p, ptrdiff_t sx, ptrdiff_t sy, uint8_t *dst, size_t n) {
+    const uint8_t *lut = sobel_lut();
+    const __m256i low_byte = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const uint8_t *q = p + i;
+        const __m256i a = widen_avx2(q - sx - sy), b = widen_avx2(q - sy), c = widen_avx2(q + sx - sy), d = widen_avx2(q - sx),
+                      e = widen_avx2(q + sx), f = widen_avx2(q - sx + sy), g = widen_avx2(q + sy), h = widen_avx2(q + sx + sy);
+        const __m256i hor = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(a, c), _mm256_slli_epi16(b, 1)),
+                                             _mm256_add_epi16(_mm256_add_epi16(f, h), _mm256_slli_epi16(g, 1)));
+        const __m256i ver = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(a, f), _mm256_slli_epi16(d, 1)),
+                                             _mm256_add_epi16(_mm256_add_epi16(c, h), _mm256_slli_epi16(e, 1)));
+        // unpack, madd e packus operam por lane: a ordem dos 16 elementos se preserva até o permute final
+        const __m256i lo = _mm256_unpacklo_epi16(hor, ver), hi = _mm256_unpackhi_epi16(hor, ver);
+        const __m256i vlo = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, _mm256_srli_epi32(_mm256_madd_epi16(lo, lo), SOBEL_LUT_SHIFT), 1), low_byte);
+        const __m256i vhi = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, _mm256_srli_epi32(_mm256_madd_epi16(hi, hi), SOBEL_LUT_SHIFT), 1), low_byte);
+        const __m256i w = _mm256_packus_epi32(vlo, vhi), v = _mm256_packus_epi16(w, w);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08)));
+    }
+    sobel_run_scalar(p, sx, sy, dst, i, n, lut);
+}
+
+/**
+ * lut[índice + offset] de 8 elementos consecutivos, um por posição de 32 bits.
+ */
+__attribute__((target("avx2")))
+static inline __m256i lut_gather_avx2(const uint8_t *lut, const uint8_t *src, __m256i offset) {
+    const __m256i idx = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src)), offset);
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, idx, 1), _mm256_set1_epi32(0xFF));
+}
+
+__attribute__((target("avx2")))
+static void lut_apply_avx2(const uint8_t *lut, const uint8_t *src, uint8_t *dst, size_t n, uint channels) {
+    if (channels != 1 && channels != 3) return lut_apply_scalar(lut, src, dst, 0, n, channels);
+    // offset[p]: deslocamento da tabela de cada elemento de um grupo de 8 que começa no canal p
+    __m256i offset[3];
+    for (uint p = 0; p < 3; p++) {
+        alignas(32) int o[8];
+        for (uint k = 0; k < 8; k++) o[k] = (p + k) % channels*256;
+        offset[p] = _mm256_load_si256((const __m256i*)o);
+    }
+    // Com 3 canais, a fase se repete a cada 48 elementos
+    const size_t step = 16*channels;
+    size_t i = 0;
+    for (; i + step <= n; i += step) {
+        for (size_t j = i; j < i + step; j += 16) {
+            const __m256i a = lut_gather_avx2(lut, src + j, offset[(j - i) % channels]);
+            const __m256i b = lut_gather_avx2(lut, src + j + 8, offset[(j - i + 8) % channels]);
+            // packus opera por lane: o permute reordena os 16 valores antes e depois do empacotamento em bytes
+            const __m256i w = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8), v = _mm256_packus_epi16(w, w);
+            _mm_storeu_si128((__m128i*)(dst + j), _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08)));
+        }
+    }
+    lut_apply_scalar(lut, src, dst, i, n, channels);
+}
+
+//
+// Vazão de operações inteiras: 8 cadeias de somas independentes; a barreira vazia (que também mantém os
+// resultados vivos) impede que o compilador junte as somas ou as vetorize
+//
+
+#define _INT_ADD_ROUNDS(ADD, BARRIER)                                                  \
+    for (uint64_t i = 0; i < iterations; i++) {                                           \
+        a0 = ADD(a0, step); a1 = ADD(a1, step); a2 = ADD(a2, step); a3 = ADD(a3, step);   \
+        a4 = ADD(a4, step); a5 = ADD(a5, step); a6 = ADD(a6, step); a7 = ADD(a7, step);   \
+        asm volatile("" : "+" BARRIER(a0), "+" BARRIER(a1), "+" BARRIER(a2), "+" BARRIER(a3), \
+                          "+" BARRIER(a4), "+" BARRIER(a5), "+" BARRIER(a6), "+" BARRIER(a7)); \
+    }
+
+#define _SCALAR_ADD(a, b) ((a) + (b))
+#define _REG(a) "r"(a)
+#define _VREG(a) "x"(a)
+
+static uint64_t int_add_scalar(uint64_t iterations) {
+    uint32_t a0 = 0, a1 = 1, a2 = 2, a3 = 3, a4 = 4, a5 = 5, a6 = 6, a7 = 7, step = 3;
+    _INT_ADD_ROUNDS(_SCALAR_ADD, _REG)
+    return iterations*8;
+}
+
+__attribute__((target("sse4.1")))
+static uint64_t int_add_sse(uint64_t iterations) {
+    __m128i a0 = _mm_set1_epi16(0), a1 = _mm_set1_epi16(1), a2 = _mm_set1_epi16(2), a3 = _mm_set1_epi16(3);
+    __m128i a4 = _mm_set1_epi16(4), a5 = _mm_set1_epi16(5), a6 = _mm_set1_epi16(6), a7 = _mm_set1_epi16(7);
+    const __m128i step = _mm_set1_epi16(3);
+    _INT_ADD_ROUNDS(_mm_add_epi16, _VREG)
+    return iterations*8*8;
+}
+
+__attribute__((target("avx2")))
+static uint64_t int_add_avx2(uint64_t iterations) {
+    __m256i a0 = _mm256_set1_epi16(0), a1 = _mm256_set1_epi16(1), a2 = _mm256_set1_epi16(2), a3 = _mm256_set1_epi16(3);
+    __m256i a4 = _mm256_set1_epi16(4), a5 = _mm256_set1_epi16(5), a6 = _mm256_set1_epi16(6), a7 = _mm256_set1_epi16(7);
+    const __m256i step = _mm256_set1_epi16(3);
+    _INT_ADD_ROUNDS(_mm256_add_epi16, _VREG)
+    return iterations*8*16;
+}
+
+//
+// Despacho em tempo de execução
+//
+
+enum class Isa { SCALAR, SSE41, AVX2 };
+
+static Isa detect() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Isa::SSE41;
+    return Isa::SCALAR;
+}
+static const Isa selected = detect();
+
+void gray_planar(GrayOp op, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                 uint8_t *dr, uint8_t *dg, uint8_t *db, size_t n) {
+    switch (selected) {
+        case Isa::AVX2: return gray_planar_avx2(op, r, g, b, dr, dg, db, n);
+        case Isa::SSE41: return gray_planar_sse(op, r, g, b, dr, dg, db, n);
+        default: return gray_planar_scalar(op, r, g, b, dr, dg, db, 0, n);
+    }
+}
+
+void gray_interleaved_rgb(GrayOp op, const uint8_t *src, uint8_t *dst, size_t n) {
+    switch (selected) {
+        case Isa::AVX2: return gray_interleaved_avx2(op, src, dst, n);
+        case Isa::SSE41: return gray_interleaved_sse(op, src, dst, n);
+        default: return gray_interleaved_scalar(op, src, dst, 0, n);
+    }
+}
+
+void deinterleave_rgb(const uint8_t *src, uint8_t *r, uint8_t *g, uint8_t *b, size_t n) {
+    switch (selected) {
+        case Isa::AVX2: return deinterleave_rgb_avx2(src, r, g, b, n);
+        case Isa::SSE41: return deinterleave_rgb_sse(src, r, g, b, n);
+        default: return deinterleave_rgb_scalar(src, r, g, b, 0, n);
+    }
+}
+
+void interleave_rgb(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, size_t n) {
+    switch (selected) {
+        case Isa::AVX2: return interleave_rgb_avx2(r, g, b, dst, n);
+        case Isa::SSE41: return interleave_rgb_sse(r, g, b, dst, n);
+        default: return interleave_rgb_scalar(r, g, b, dst, 0, n);
+    }
+}
+
+void sobel_run(const uint8_t *src, ptrdiff_t sx, ptrdiff_t sy, uint8_t *dst, size_t n) {
+    switch (selected) {
+        case Isa::AVX2: return sobel_run_avx2(src, sx, sy, dst, n);
+        case Isa::SSE41: return sobel_run_sse(src, sx, sy, dst, n);
+        default: return sobel_run_scalar(src, sx, sy, dst, 0, n, sobel_lut());
+    }
+}
+
+void lut_apply(const uint8_t *lut, const uint8_t *src, uint8_t *dst, size_t n, uint channels) {
+    switch (selected) {
+        case Isa::AVX2: return lut_apply_avx2(lut, src, dst, n, channels);
+        default: return lut_apply_scalar(lut, src, dst, 0, n, channels);
+    }
+}
+
+uint64_t int_add_throughput(uint64_t iterations, bool scalar) {
+    if (scalar) return int_add_scalar(iterations);
+    switch (selected) {
+        case Isa::AVX2: return int_add_avx2(iterations);
+        case Isa::SSE41: return int_add_sse(iterations);
+        default: return int_add_scalar(iterations);
+    }
+}
+
+const char *isa() {
+    switch (selected) {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+}  // namespace simd
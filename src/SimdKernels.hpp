@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Implementações vetorizadas (SSE4.1/AVX2, escolhidas em tempo de execução, com fallback escalar)
+ * dos algoritmos de escala de cinza ponto-a-ponto sobre imagens de 8 bits, do Sobel em ponto fixo, da aplicação de
+ * tabelas (LUT) e da (des)intercalação RGB.
+ * Os resultados são idênticos aos das versões escalares em ImagingAlgorithms.hpp.
+ */
+namespace simd {
+
+enum class GrayOp { AVERAGING, LUMA, DESATURATION, DE_COMPOSITION_MAX, DE_COMPOSITION_MIN };
+
+/**
+ * Versão escalar de um pixel, usada também para o resto que não completa um vetor.
+ */
+inline uint gray_scalar(GrayOp op, uint r, uint g, uint b) {
+    switch (op) {
+        default:
+        case GrayOp::AVERAGING: return (r + g + b)/3;
+        case GrayOp::LUMA: return (r*30 + g*59 + b*11)/100;
+        case GrayOp::DESATURATION: return (std::max(std::max(r, g), b) + std::min(std::min(r, g), b))/2;
+        case GrayOp::DE_COMPOSITION_MAX: return std::max(std::max(r, g), b);
+        case GrayOp::DE_COMPOSITION_MIN: return std::min(std::min(r, g), b);
+    }
+}
+
+/**
+ * Layout planar (um plano contíguo por canal): lê r/g/b e escreve o tom de cinza nos três planos de destino.
+ */
+void gray_planar(GrayOp op, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                 uint8_t *dr, uint8_t *dg, uint8_t *db, size_t n);
+
+/**
+ * Layout intercalado RGB (3 bytes por pixel): src e dst possuem 3*n bytes.
+ */
+void gray_interleaved_rgb(GrayOp op, const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * Conversão entre RGB intercalado (3*n bytes) e três planos de n bytes, usada na troca de layout.
+ */
+void deinterleave_rgb(const uint8_t *src, uint8_t *r, uint8_t *g, uint8_t *b, size_t n);
+void interleave_rgb(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *dst, size_t n);
+
+/**
+ * Tabela da magnitude de Sobel em 8 bits: sobel_lut()[g² >> SOBEL_LUT_SHIFT], com g² = hor² + ver², difere em no
+ * máximo ±1 de 255*sqrt(g²)/maxdiv (o cálculo em double de sobel), limitado a 255.
+ */
+constexpr int SOBEL_LUT_SHIFT = 6;
+const uint8_t *sobel_lut();
+
+/**
+ * Sobel de n elementos consecutivos a partir de src, cujos vizinhos em x e em y estão a sx e sy elementos de
+ * distância: gradientes em inteiros de 16 bits e magnitude por sobel_lut(). Não testa os limites da imagem.
+ */
+void sobel_run(const uint8_t *src, ptrdiff_t sx, ptrdiff_t sy, uint8_t *dst, size_t n);
+
+/**
+ * dst[i] = lut[(i % channels)*256 + src[i]]: uma tabela de 256 entradas por canal, com channels = 1 (um plano) ou
+ * canais intercalados. lut deve ter channels*256 + LUT_PADDING bytes (o gather AVX2 lê 4 bytes por índice).
+ * Vetorizada com gather em AVX2, para 1 ou 3 canais; escalar nos demais casos.
+ */
+constexpr size_t LUT_PADDING = 3;
+void lut_apply(const uint8_t *lut, const uint8_t *src, uint8_t *dst, size_t n, uint channels);
+
+/**
+ * Executa `iterations` rodadas de 8 somas inteiras de 16 bits independentes, nos vetores mais largos do despacho
+ * (ou em registradores escalares de 32 bits com scalar = true), e retorna a quantidade de somas por elemento
+ * realizadas: a vazão máxima de operações inteiras, para o roofline.
+ */
+uint64_t int_add_throughput(uint64_t iterations, bool scalar = false);
+
+/**
+ * Conjunto de instruções escolhido pelo despacho: "avx2", "sse4.1" ou "scalar".
+ */
+const char *isa();
+
+}  // namespace simd
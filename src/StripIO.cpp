@@ -0,0 +1,65 @@
+#include <cctype>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "StripIO.hpp"
+
+/**
+ * Próximo número do cabeçalho PNM, ignorando espaços e comentários (#...).
+ */
+static bool _pnm_number(FILE *fp, uint& v) {
+    int ch;
+    while ((ch = std::fgetc(fp)) != EOF) {
+        if (ch == '#') {
+            while ((ch = std::fgetc(fp)) != EOF && ch != '\n') {}
+        } else if (!std::isspace(ch)) {
+            break;
+        }
+    }
+    if (ch == EOF || !std::isdigit(ch)) return false;
+    v = 0;
+    for (; ch != EOF && std::isdigit(ch); ch = std::fgetc(fp)) v = 10*v + (ch - '0');
+    // Exatamente um caractere de espaço separa o último campo dos pixels
+    return ch != EOF && std::isspace(ch);
+}
+
+PnmReader::PnmReader(const char *file) {
+    FILE *fp = std::fopen(file, "rb");
+    if (!fp) throw std::runtime_error(std::string("cannot open ") + file);
+    uint maxval = 0;
+    const bool ok = std::fgetc(fp) == 'P' && std::fgetc(fp) == '6' && _pnm_number(fp, width) && _pnm_number(fp, height) &&
+                    _pnm_number(fp, maxval) && maxval == 255;
+    offset = std::ftell(fp);
+    std::fclose(fp);
+    if (!ok) throw std::runtime_error(std::string(file) + " is not a binary 8-bit PPM (P6)");
+    fd = open(file, O_RDONLY);
+    if (fd < 0) throw std::runtime_error(std::string("cannot open ") + file);
+}
+
+PnmReader::~PnmReader() {
+    if (fd >= 0) close(fd);
+}
+
+void PnmReader::readRows(uint y, uint rows, uint8_t *dst) const {
+    const size_t row_bytes = size_t(width)*3, n = rows*row_bytes;
+    size_t done = 0;
+    while (done < n) {
+        const ssize_t r = pread(fd, dst + done, n - done, offset + y*row_bytes + done);
+        if (r <= 0) throw std::runtime_error("truncated PPM");
+        done += r;
+    }
+}
+
+PnmWriter::PnmWriter(const char *file, uint width, uint height) : width(width) {
+    fp = std::fopen(file, "wb");
+    if (!fp) throw std::runtime_error(std::string("cannot create ") + file);
+    std::fprintf(fp, "P6\n%u %u\n255\n", width, height);
+}
+
+PnmWriter::~PnmWriter() {
+    std::fclose(fp);
+}
+
+void PnmWriter::writeRows(const uint8_t *src, uint rows) {
+    if (std::fwrite(src, size_t(width)*3, rows, fp) != rows) throw std::runtime_error("failed to write PPM");
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * Leitura e escrita de imagens PPM binárias (P6, 8 bits) por faixas de linhas, sem carregar a imagem inteira.
+ * As linhas ficam em RGB intercalado (o layout YXC), uma após a outra.
+ */
+class PnmReader {
+   public:
+    /**
+     * Abre `file` e interpreta o cabeçalho; lança std::runtime_error se não for um P6 de 8 bits.
+     */
+    explicit PnmReader(const char *file);
+    ~PnmReader();
+
+    uint getWidth() const { return width; }
+    uint getHeight() const { return height; }
+    uint getChannels() const { return 3; }
+
+    /**
+     * Lê as linhas [y, y + rows) em `dst` (rows*width*3 bytes). Linhas podem ser relidas (halos).
+     */
+    void readRows(uint y, uint rows, uint8_t *dst) const;
+
+   protected:
+    int fd = -1;
+    uint width = 0, height = 0;
+    uint64_t offset = 0; // Início dos pixels
+};
+
+class PnmWriter {
+   public:
+    PnmWriter(const char *file, uint width, uint height);
+    ~PnmWriter();
+
+    /**
+     * Acrescenta `rows` linhas (rows*width*3 bytes) ao arquivo.
+     */
+    void writeRows(const uint8_t *src, uint rows);
+
+   protected:
+    FILE *fp;
+    uint width;
+};
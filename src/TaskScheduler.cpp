@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <sched.h>
+#include "TaskScheduler.hpp"
+#include "Numa.hpp"
+
+#ifdef PARALLELIZE
+#include <omp.h>
+#endif
+
+// Índice da thread no pool de roubo de trabalho (0 na thread que chama run())
+static thread_local uint _worker_id = 0;
+
+static void _pin_to_core(pthread_t t, uint id) {
+    // Preenche um nó NUMA antes de passar ao próximo
+    const auto& cpus = Numa::cpus();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[id % cpus.size()], &set);
+    pthread_setaffinity_np(t, sizeof(set), &set);
+}
+
+TaskScheduler::TaskScheduler(uint n, bool pin) {
+    n = std::max(1u, n);
+    for (uint i = 0; i < n; i++) workers.emplace_back(new Worker());
+    if (pin) _pin_to_core(pthread_self(), 0);
+    for (uint i = 1; i < n; i++) {
+        threads.emplace_back(&TaskScheduler::loop, this, i);
+        if (pin) _pin_to_core(threads.back().native_handle(), i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv_start.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+bool TaskScheduler::pop(uint id, long& task) {
+    Worker& w = *workers[id];
+    std::lock_guard<std::mutex> lk(w.m);
+    if (w.tasks.empty()) return false;
+    task = w.tasks.front();
+    w.tasks.pop_front();
+    return true;
+}
+
+bool TaskScheduler::steal(uint id, long& task) {
+    for (uint k = 1; k < workers.size(); k++) {
+        Worker& w = *workers[(id + k) % workers.size()];
+        std::lock_guard<std::mutex> lk(w.m);
+        if (w.tasks.empty()) continue;
+        task = w.tasks.back();
+        w.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::work(uint id) {
+    long task;
+    // As tarefas só são criadas em run(): quando não há o que consumir nem roubar, não haverá mais.
+    while (pop(id, task) || (stealing && steal(id, task))) {
+        (*job)(task);
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> lk(m);
+            cv_done.notify_all();
+        }
+    }
+}
+
+void TaskScheduler::loop(uint id) {
+    _worker_id = id;
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv_start.wait(lk, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            active++;
+        }
+        work(id);
+        {
+            std::lock_guard<std::mutex> lk(m);
+            active--;
+        }
+        cv_done.notify_all();
+    }
+}
+
+void TaskScheduler::run(long n, const std::function<void(long)>& fn, bool steal) {
+    const long t = workers.size();
+    {
+        std::lock_guard<std::mutex> lk(m);
+        job = &fn;
+        stealing = steal;
+        remaining = n;
+        for (long i = 0; i < t; i++) {
+            std::lock_guard<std::mutex> wlk(workers[i]->m);
+            for (long k = i*n/t; k < (i + 1)*n/t; k++) workers[i]->tasks.push_back(k);
+        }
+        generation++;
+    }
+    cv_start.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lk(m);
+    // Uma thread pode acordar só depois de as demais terminarem: espera também as tarefas ainda na sua fila
+    cv_done.wait(lk, [&] { return remaining == 0 && active == 0; });
+    job = nullptr;
+}
+
+namespace parallel {
+
+static Backend _backend = Backend::OPENMP;
+static std::unique_ptr<TaskScheduler> _scheduler;
+
+void configure(Backend b, uint n, bool pin) {
+    _backend = b;
+    _scheduler.reset();
+    if (b == Backend::WORK_STEALING) {
+        _scheduler.reset(new TaskScheduler(n ? n : std::thread::hardware_concurrency(), pin));
+    }
+#ifdef PARALLELIZE
+    else {
+        if (n) omp_set_num_threads(n);
+        if (pin) {
+            #pragma omp parallel
+            _pin_to_core(pthread_self(), omp_get_thread_num());
+        }
+    }
+#endif
+}
+
+Backend backend() { return _backend; }
+
+uint thread_index() {
+    if (_backend == Backend::WORK_STEALING) return _worker_id;
+#ifdef PARALLELIZE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+const char *backendName() { return _backend == Backend::WORK_STEALING ? "steal" : "omp"; }
+
+uint threads() {
+    if (_backend == Backend::WORK_STEALING) return _scheduler->size();
+#ifdef PARALLELIZE
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Verdadeiro nas threads que executam um corpo de for_range
+static thread_local bool _inside = false;
+
+void for_range(long n, const std::function<void(long)>& fn) {
+    if (_inside) {
+        // Um nível de paralelismo apenas: o laço interno roda na thread que o encontrou
+        for (long i = 0; i < n; i++) fn(i);
+        return;
+    }
+    const std::function<void(long)> body = [&](long i) {
+        _inside = true;
+        fn(i);
+        _inside = false;
+    };
+    if (_backend == Backend::WORK_STEALING) {
+        _scheduler->run(n, body);
+        return;
+    }
+#ifdef PARALLELIZE
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (long i = 0; i < n; i++) body(i);
+}
+
+void for_each_thread(const std::function<void(long)>& fn) {
+    const long n = threads();
+    if (_inside) {
+        for (long i = 0; i < n; i++) fn(i);
+        return;
+    }
+    const std::function<void(long)> body = [&](long i) {
+        _inside = true;
+        fn(i);
+        _inside = false;
+    };
+    if (_backend == Backend::WORK_STEALING) {
+        _scheduler->run(n, body, false);
+        return;
+    }
+#ifdef PARALLELIZE
+    #pragma omp parallel num_threads(n)
+    body(omp_get_thread_num());
+#else
+    body(0);
+#endif
+}
+
+}  // namespace parallel
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool de threads com uma fila de tarefas por thread e roubo de trabalho.
+ * Cada chamada a run() distribui os índices [0, n) em blocos contíguos, um por thread; cada thread consome
+ * o próprio bloco em ordem e, ao esvaziá-lo, rouba tarefas do fim da fila das demais.
+ * A thread que chama run() participa como a thread 0.
+ */
+class TaskScheduler {
+   public:
+    TaskScheduler(uint threads, bool pin);
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * steal = false: cada thread executa apenas o próprio bloco (com n = size(), a tarefa i na thread i).
+     */
+    void run(long n, const std::function<void(long)>& fn, bool steal = true);
+    uint size() const { return workers.size(); }
+
+   protected:
+    struct Worker {
+        std::mutex m;
+        std::deque<long> tasks;
+    };
+
+    bool pop(uint id, long& task);
+    bool steal(uint id, long& task);
+    void work(uint id);
+    void loop(uint id);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable cv_start, cv_done;
+    const std::function<void(long)> *job = nullptr;
+    uint64_t generation = 0;
+    uint active = 0;
+    bool stopping = false;
+    bool stealing = true;
+    std::atomic<long> remaining{0}; // Tarefas de run() ainda não concluídas
+};
+
+/**
+ * Seleção, em tempo de execução, de como os algoritmos distribuem suas unidades de trabalho (tiles, faixas de linhas).
+ */
+namespace parallel {
+
+enum class Backend { OPENMP, WORK_STEALING };
+
+/**
+ * threads = 0 usa a quantidade padrão (OMP_NUM_THREADS ou o número de núcleos).
+ * Fora da build PARALLELIZE, o backend OPENMP executa sequencialmente.
+ */
+void configure(Backend backend, uint threads, bool pin);
+Backend backend();
+const char *backendName();
+uint threads();
+
+/**
+ * Índice da thread corrente em [0, threads()) dentro de um for_range; 0 fora dele.
+ */
+uint thread_index();
+
+/**
+ * Executa fn(i) para i em [0, n) com o backend configurado. Chamadas aninhadas (de dentro de fn) executam
+ * sequencialmente na thread corrente, sem abrir outra região paralela.
+ */
+void for_range(long n, const std::function<void(long)>& fn);
+
+/**
+ * Executa fn(i) uma vez em cada thread i de [0, threads()), sem redistribuição; sequencial se aninhado.
+ */
+void for_each_thread(const std::function<void(long)>& fn);
+
+}  // namespace parallel
@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include "Image3D.hpp"
+#include "ImageConvert.hpp"
+
+/**
+ * Percurso de retângulos de uma imagem na ordem de memória do seu layout, escolhido em tempo de compilação a partir
+ * do PixelOrder: o laço externo segue a primeira dimensão de memória e o interno a terceira (contígua). Nos layouts
+ * em blocos, percorre blocos de 8x8 pixels, que ocupam 64 posições consecutivas tanto em TILE8 quanto em MORTON.
+ * Com layout_order = false, todos os layouts usam a ordem (y, x, c) original, como referência para o benchmark.
+ */
+struct TraversalOptions {
+    static inline bool layout_order = true;
+};
+
+template<typename ImageType>
+struct Traversal {
+    static constexpr PixelOrder order = ImageType::pixel_order;
+    static constexpr convert::Axes axes = convert::axes(order);
+
+    /**
+     * x varia mais devagar que y na memória (XYC, XCY, CXY): os laços espaciais são percorridos coluna a coluna.
+     */
+    static constexpr bool x_outer = axes.first == convert::X || (axes.first == convert::C && axes.second == convert::X);
+
+    /**
+     * Buffer único com passos constantes (convert::strides): vizinhos são acessados por aritmética de ponteiros.
+     */
+    static constexpr bool strided = ImageType::is_memblock && !_PixelOrder_isBlocked(order);
+
+    static bool layout_order() { return TraversalOptions::layout_order; }
+
+    /**
+     * Chama fn(x, y) para cada pixel de [x0, x1) x [y0, y1).
+     */
+    template<typename Fn>
+    static void pixels(uint x0, uint y0, uint x1, uint y1, Fn fn) {
+        if (!layout_order()) {
+            for (uint y = y0; y < y1; y++)
+                for (uint x = x0; x < x1; x++) fn(x, y);
+        } else if constexpr (_PixelOrder_isBlocked(order)) {
+            for (uint by = y0 & ~7u; by < y1; by += 8)
+                for (uint bx = x0 & ~7u; bx < x1; bx += 8)
+                    for (uint y = std::max(by, y0); y < std::min(by + 8, y1); y++)
+                        for (uint x = std::max(bx, x0); x < std::min(bx + 8, x1); x++) fn(x, y);
+        } else if constexpr (x_outer) {
+            for (uint x = x0; x < x1; x++)
+                for (uint y = y0; y < y1; y++) fn(x, y);
+        } else {
+            for (uint y = y0; y < y1; y++)
+                for (uint x = x0; x < x1; x++) fn(x, y);
+        }
+    }
+
+    /**
+     * Chama fn(x, y, c) para cada elemento de [x0, x1) x [y0, y1) x [0, channels).
+     */
+    template<typename Fn>
+    static void elements(uint x0, uint y0, uint x1, uint y1, uint channels, Fn fn) {
+        if constexpr (!_PixelOrder_isBlocked(order)) {
+            if (layout_order()) {
+                const uint lo[3] = {x0, y0, 0}, hi[3] = {x1, y1, channels};
+                uint p[3];
+                for (p[axes.first] = lo[axes.first]; p[axes.first] < hi[axes.first]; p[axes.first]++)
+                    for (p[axes.second] = lo[axes.second]; p[axes.second] < hi[axes.second]; p[axes.second]++)
+                        for (p[axes.third] = lo[axes.third]; p[axes.third] < hi[axes.third]; p[axes.third]++)
+                            fn(p[convert::X], p[convert::Y], p[convert::C]);
+                return;
+            }
+        }
+        pixels(x0, y0, x1, y1, [&](uint x, uint y) {
+            for (uint c = 0; c < channels; c++) fn(x, y, c);
+        });
+    }
+
+    /**
+     * Chama fn(x, y, c, n) para cada sequência contígua de [x0, x1) x [y0, y1) x [0, channels): n elementos na memória
+     * a partir de &img(x, y, c). Com os canais intercalados e todos percorridos, a sequência abrange uma linha inteira
+     * do retângulo. Apenas para layouts strided.
+     */
+    template<typename Fn>
+    static void runs(const ImageType &img, uint x0, uint y0, uint x1, uint y1, uint channels, Fn fn) {
+        static_assert(strided, "runs() requires a MemBlock linear layout");
+        const uint lo[3] = {x0, y0, 0}, hi[3] = {x1, y1, channels};
+        uint p[3];
+        p[axes.third] = lo[axes.third];
+        if (axes.third == convert::C && channels == img.getChannels()) {
+            p[axes.second] = lo[axes.second];
+            const uint n = (hi[axes.second] - lo[axes.second])*channels;
+            for (p[axes.first] = lo[axes.first]; p[axes.first] < hi[axes.first]; p[axes.first]++)
+                fn(p[convert::X], p[convert::Y], p[convert::C], n);
+            return;
+        }
+        const uint n = hi[axes.third] - lo[axes.third];
+        for (p[axes.first] = lo[axes.first]; p[axes.first] < hi[axes.first]; p[axes.first]++)
+            for (p[axes.second] = lo[axes.second]; p[axes.second] < hi[axes.second]; p[axes.second]++)
+                fn(p[convert::X], p[convert::Y], p[convert::C], n);
+    }
+};
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sys/resource.h>
+#include "benchmark.hpp"
+
+bool PeakRss::reset() {
+    std::ofstream f("/proc/self/clear_refs");
+    return f && (f << "5").flush();
+}
+
+long PeakRss::kb() {
+    std::ifstream f("/proc/self/status");
+    for (std::string line; std::getline(f, line);) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stol(line.substr(6));
+    }
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+}
+
+BenchStats::BenchStats(std::vector<int64_t> s) : samples(std::move(s)) {
+    if (samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    min = samples.front();
+    max = samples.back();
+    median = n % 2 ? samples[n/2] : (samples[n/2 - 1] + samples[n/2])/2;
+    p95 = samples[size_t(std::ceil(0.95*n)) - 1]; // nearest-rank
+
+    for (const auto& i : samples) mean += i;
+    mean /= n;
+    if (n > 1) {
+        for (const auto& i : samples) stddev += (i - mean)*(i - mean);
+        stddev = std::sqrt(stddev/(n - 1));
+    }
+}
+
+static void _json_escape(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (const char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+void BenchWriter::write(const BenchRecord& r) {
+    if (format == Format::CSV) {
+        std::vector<std::string> keys;
+        for (const auto& f : r.fields) keys.push_back(f.key);
+        if (keys != header) {
+            for (size_t i = 0; i < keys.size(); i++) out << (i ? ", " : "") << keys[i];
+            out << "\n";
+            header = std::move(keys);
+        }
+        for (size_t i = 0; i < r.fields.size(); i++) out << (i ? ", " : "") << r.fields[i].value;
+        out << "\n";
+    } else {
+        out << "{";
+        for (size_t i = 0; i < r.fields.size(); i++) {
+            if (i) out << ", ";
+            _json_escape(out, r.fields[i].key);
+            out << ": ";
+            if (r.fields[i].numeric) out << r.fields[i].value;
+            else _json_escape(out, r.fields[i].value);
+        }
+        out << "}\n";
+    }
+    out.flush();
+}
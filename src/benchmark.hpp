@@ -1,6 +1,10 @@
 #pragma once
 #include <chrono>
 #include <string>
+#include <vector>
+#include <ostream>
+#include <sstream>
+#include <type_traits>
 #include <unistd.h>
 
 #define CLOCK_PRECISION microseconds
@@ -16,6 +20,100 @@ struct BenchClock {
         const auto end = std::chrono::high_resolution_clock::now();
         return std::chrono::duration_cast<std::chrono::CLOCK_PRECISION>(end - start).count();
     }
+    // Converte um valor em CLOCK_PRECISION para segundos.
+    static double toSeconds(double elapsed) {
+        using period = std::chrono::CLOCK_PRECISION::period;
+        return elapsed * double(period::num) / double(period::den);
+    }
+};
+
+/**
+ * Pico de memória residente do processo (VmHWM), em KiB.
+ * reset() zera o pico para a memória residente atual (/proc/self/clear_refs), permitindo medir um trecho isolado;
+ * retorna false se o kernel não oferecer isso, caso em que kb() é o pico desde o início do processo.
+ */
+struct PeakRss {
+    static bool reset();
+    static long kb();
+};
+
+/**
+ * Estatísticas de um conjunto de repetições cronometradas (em CLOCK_PRECISION).
+ */
+struct BenchStats {
+    std::vector<int64_t> samples; // Ordenadas
+    int64_t min = 0, median = 0, p95 = 0, max = 0;
+    double mean = 0, stddev = 0;
+
+    BenchStats() {}
+    explicit BenchStats(std::vector<int64_t> samples);
+};
+
+/**
+ * Uma linha de resultado do benchmark, com os campos na ordem em que foram inseridos.
+ */
+struct BenchRecord {
+    struct Field {
+        std::string key, value;
+        bool numeric;
+    };
+    std::vector<Field> fields;
+
+    template<typename T>
+    BenchRecord& set(const std::string& key, const T& value) {
+        std::ostringstream ss;
+        ss << value;
+        constexpr bool numeric = std::is_arithmetic<T>::value;
+        for (auto& f : fields) {
+            if (f.key == key) {
+                f.value = ss.str();
+                f.numeric = numeric;
+                return *this;
+            }
+        }
+        fields.push_back({key, ss.str(), numeric});
+        return *this;
+    }
+
+    const std::string get(const std::string& key) const {
+        for (const auto& f : fields) if (f.key == key) return f.value;
+        return "";
+    }
+};
+
+/**
+ * Escreve BenchRecords em CSV ou JSON (um objeto por linha).
+ * Em CSV, o cabeçalho é escrito antes do primeiro registro e novamente sempre que as colunas mudam.
+ */
+struct BenchWriter {
+    enum class Format { CSV, JSON };
+
+    BenchWriter(std::ostream& out, Format format) : out(out), format(format) {}
+    void write(const BenchRecord& r);
+
+    static Format parseFormat(const std::string& s) { return s == "json" ? Format::JSON : Format::CSV; }
+
+   protected:
+    std::ostream& out;
+    Format format;
+    std::vector<std::string> header;
+};
+
+struct PerfCounters;
+struct Roofline;
+
+/**
+ * Opções do modo de benchmark por algoritmo.
+ */
+struct BenchOptions {
+    uint repetitions = 5;
+    PerfCounters *perf = nullptr; // Contadores de hardware opcionais
+    bool fused = false;           // Também cronometra todos os algoritmos habilitados em uma única varredura
+    uint dirty = 0;               // Lado da edição central cujo recálculo incremental também é cronometrado (0 desativa)
+    bool conversion = false;      // Também cronometra a conversão de/para os layouts MemBlock planar e intercalado
+    bool numa = false;            // Acrescenta as páginas da origem e do destino em cada nó NUMA (Numa::report)
+    const Roofline *roofline = nullptr; // Limites calibrados, para anotar a fração do roofline atingida
+    bool samples = false;         // Acrescenta as amostras das repetições ("samples", ver results::join)
 };
 
 struct ImagingBenchmark {
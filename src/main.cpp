@@ -4,7 +4,11 @@
 #include <random>
 #include <algorithm>
 #include <unordered_set>
+#include <unordered_map>
+#include <fstream>
+#include <memory>
 #include "ImagingAlgorithms.hpp"
+#include "Implementations.hpp"
 #include "include/tclap/CmdLine.h"
 
 #ifndef GITFLAG
@@ -37,36 +41,81 @@ int main(int argc, const char* argv[]) {
     BenchClock clock;
 
     // Setup das diferentes implementações de benchmarking
-    std::vector<ImagingAlgorithmsBase*> benchType = {
-        new ImagingAlgorithms<Image3D<PixelOrder::XYC, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::XYC, true>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::XCY, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::XCY, true>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::YXC, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::YXC, true>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::YCX, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::YCX, true>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::CXY, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::CXY, true>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::CYX, false>>(),
-        new ImagingAlgorithms<Image3D<PixelOrder::CYX, true>>()
-    };
+    std::vector<ImagingAlgorithmsBase*> benchType = make_implementations();
 
     // Interpreta a linha de comando
     std::vector<std::string> f_allowed, a_allowed = benchType[0]->getAlgorithms();
     for (const auto& i : benchType) {
         f_allowed.push_back(i->getDesc());
     }
-    TCLAP::ValuesConstraint<std::string> f_allowedVals(f_allowed), a_allowedVals(a_allowed);
+    std::vector<std::string> fmt_allowed = {"csv", "json"}, sched_allowed = {"omp", "steal"}, ptype_allowed = {"u8", "u16", "f32"};
+    TCLAP::ValuesConstraint<std::string> f_allowedVals(f_allowed), a_allowedVals(a_allowed), fmt_allowedVals(fmt_allowed);
+    TCLAP::ValuesConstraint<std::string> sched_allowedVals(sched_allowed), ptype_allowedVals(ptype_allowed);
 
     TCLAP::CmdLine parser("Image benchmark");
     TCLAP::SwitchArg arg_dummy("d", "dummy", "Disables dummy warm benchmark on startup", parser);
     TCLAP::SwitchArg arg_pifilter("", "print-filter-implementations-choices", "Print implementations available and exit", parser);
     TCLAP::SwitchArg arg_pafilter("", "print-filter-algorithms-choices", "Print benchmark-algorithms available and exit", parser);
     TCLAP::MultiArg<std::string> arg_filter("f", "filter", "Filter what implementations will be used", false, &f_allowedVals, parser);
+    TCLAP::MultiArg<std::string> arg_ptype("", "pixel-type", "Pixel types of the implementations to evaluate (default: u8 only, unless -f names others)", false, &ptype_allowedVals, parser);
     TCLAP::MultiArg<std::string> arg_afilter("a", "algorithm", "Filter what benchmark-algorithms will be used", false, &a_allowedVals, parser);
+    TCLAP::SwitchArg arg_peralgo("p", "per-algorithm", "Time each enabled benchmark-algorithm separately and report statistics", parser);
+    TCLAP::ValueArg<uint> arg_reps("r", "repetitions", "Timed repetitions per (implementation, algorithm, image) in per-algorithm mode", false, 5, "int", parser);
+    TCLAP::SwitchArg arg_roofline("", "roofline", "Calibrate memory bandwidth and integer throughput at startup and annotate per-algorithm results with bytes, operations and percentage of the roofline", parser);
+    TCLAP::ValueArg<uint> arg_rooflinemb("", "roofline-size", "Size of each array of the bandwidth calibration", false, 64, "MiB", parser);
+    TCLAP::SwitchArg arg_perf("", "perf", "Capture hardware performance counters (perf_event_open) in per-algorithm mode", parser);
+    TCLAP::SwitchArg arg_fused("", "fused", "In per-algorithm mode, also time all enabled algorithms fused into a single tiled pass", parser);
+    TCLAP::ValueArg<uint> arg_dirty("", "dirty-edit", "In per-algorithm mode, also time recomputing all enabled algorithms only around a centered square edit of this side, against a full recompute (0 disables)", false, 0, "pixels", parser);
+    TCLAP::SwitchArg arg_convert("", "conversion", "In per-algorithm mode, also time the layout conversion from/to the planar and interleaved MemBlock layouts", parser);
+    TCLAP::SwitchArg arg_pipeline("", "pipeline", "Overlap image decoding with computation and report end-to-end throughput", parser);
+    TCLAP::ValueArg<uint> arg_loaders("", "loaders", "Decoding threads of the pipeline mode (0 loads serially)", false, 2, "int", parser);
+    TCLAP::ValueArg<uint> arg_depth("", "pipeline-depth", "Maximum number of decoded images waiting in the pipeline", false, 2, "int", parser);
+    TCLAP::SwitchArg arg_batch("", "batch", "Process all images as one batch, timing parallelism within each image and across images (one image per thread), and report images/s", parser);
+    TCLAP::ValueArg<size_t> arg_batchpx("", "batch-pixels", "Largest image (in pixels) for which the automatic batch policy parallelizes across images", false, ImagingAlgorithmsBase::batch_pixels, "pixels", parser);
+    TCLAP::ValueArg<uint> arg_stream("", "stream-rows", "Stream binary PPM (P6) inputs in strips of this many rows, bounding memory to a few strips (0 disables)", false, 0, "int", parser);
+    TCLAP::ValueArg<std::string> arg_streamout("", "stream-output", "In streaming mode, write the result of the last enabled algorithm to this PPM", false, "", "path", parser);
+    TCLAP::ValueArg<uint> arg_rowalign("", "row-align", "Align and pad the rows of MemBlock images to this many bytes (power of two; 0 keeps them packed)", false, 0, "bytes", parser);
+    TCLAP::SwitchArg arg_hugepages("", "huge-pages", "Allocate MemBlock images 2 MiB-aligned and ask for transparent huge pages", parser);
+    TCLAP::SwitchArg arg_pitchcmp("", "pitch-compare", "In per-algorithm mode, time each algorithm with packed rows and with rows padded to --row-align (64 if unset)", parser);
+    TCLAP::SwitchArg arg_travcmp("", "traversal-compare", "In per-algorithm mode, time each algorithm with the generic (y, x, c) traversal and with the traversal matched to the memory layout", parser);
+    TCLAP::SwitchArg arg_pool("", "pool", "Reuse image buffers across images, iterations and implementations, and back Pointers images with a single slab", parser);
+    TCLAP::ValueArg<uint> arg_poolcap("", "pool-capacity", "Maximum size of the idle buffers kept by --pool", false, 1024, "MiB", parser);
+    TCLAP::ValueArg<std::string> arg_rawcache("", "raw-cache", "Directory of pre-converted raw images, written on first load and memory-mapped afterwards", false, "", "dir", parser);
+    TCLAP::ValueArg<std::string> arg_format("", "format", "Output format of the per-algorithm mode", false, "csv", &fmt_allowedVals, parser);
+    TCLAP::ValueArg<std::string> arg_output("o", "output", "Write per-algorithm results to this file instead of stdout", false, "", "path", parser);
+    TCLAP::ValueArg<std::string> arg_results("", "results", "Append the per-algorithm results, with the commit and the repetition samples, to this JSON-lines file", false, "", "path", parser);
+    TCLAP::ValueArg<std::string> arg_compare("", "compare", "Compare the per-algorithm results with a --results file (Mann-Whitney on the samples) and exit with 1 on a significant slowdown", false, "", "path", parser);
+    TCLAP::ValueArg<double> arg_alpha("", "alpha", "Significance level of --compare", false, 0.01, "p", parser);
+    TCLAP::ValueArg<double> arg_threshold("", "threshold", "Smallest median change that --compare reports", false, 5, "percent", parser);
+    TCLAP::ValueArg<uint> arg_bradius("", "blur-radius", "Radius of the blur window (2 gives the original 5x5 blur)", false, 2, "int", parser);
+    TCLAP::ValueArg<uint> arg_tilew("", "tile-width", "Tile width of the stencil engine (0 keeps each implementation's default)", false, 0, "int", parser);
+    TCLAP::ValueArg<uint> arg_tileh("", "tile-height", "Tile height of the stencil engine (0 keeps each implementation's default)", false, 0, "int", parser);
+    TCLAP::SwitchArg arg_autotune("", "autotune-tiles", "Pick the fastest tile size per implementation using the first input image", parser);
+    TCLAP::ValueArg<std::string> arg_sched("", "scheduler", "Parallel backend: OpenMP loops (serial outside the PARALLELIZE build) or the work-stealing thread pool", false, "omp", &sched_allowedVals, parser);
+    TCLAP::ValueArg<uint> arg_threads("t", "threads", "Number of threads (0 uses the backend default)", false, 0, "int", parser);
+    TCLAP::SwitchArg arg_pin("", "pin", "Pin each thread to a core, filling one NUMA node before the next", parser);
+    TCLAP::SwitchArg arg_firsttouch("", "first-touch", "Zero new MemBlock buffers in parallel, one contiguous block of rows per thread, so that each page lands on the NUMA node of the thread that processes it", parser);
+    TCLAP::SwitchArg arg_numareport("", "numa-report", "In per-algorithm mode, report the pages of the source and destination images on each NUMA node (MemBlock only)", parser);
+    TCLAP::ValueArg<uint> arg_fakenuma("", "fake-numa", "Simulate this many NUMA nodes, thread i on node i*nodes/threads, to check the placement on single-node machines", false, 0, "nodes", parser);
+    TCLAP::MultiArg<uint> arg_sweep("", "thread-sweep", "Repeat the per-algorithm mode for each of these thread counts, reporting speedup and efficiency relative to the first", false, "int", parser);
     TCLAP::UnlabeledMultiArg<std::string> files("files", "Input images", true, "image-path", parser);
     parser.parse(argc, argv);
+    ImagingAlgorithmsBase::blur_radius = arg_bradius.getValue();
+    ImagingAlgorithmsBase::batch_pixels = arg_batchpx.getValue();
+    RawCache::dir = arg_rawcache.getValue();
+    const size_t row_align = arg_rowalign.getValue();
+    if (row_align & (row_align - 1)) {
+        std::cerr << "--row-align must be a power of two\n";
+        return 1;
+    }
+    RowPitch::alignment = row_align;
+    RowPitch::huge_pages = arg_hugepages.isSet();
+    BufferPool::enabled = arg_pool.isSet();
+    BufferPool::capacity = size_t(arg_poolcap.getValue()) << 20;
+    const auto backend = arg_sched.getValue() == "steal" ? parallel::Backend::WORK_STEALING : parallel::Backend::OPENMP;
+    parallel::configure(backend, arg_threads.getValue(), arg_pin.isSet());
+    Numa::first_touch = arg_firsttouch.isSet();
+    Numa::fake_nodes = arg_fakenuma.getValue();
 
     if (arg_pafilter.isSet()) {
         for (const auto& i : a_allowed) std::cout << i << "\n";
@@ -81,9 +130,16 @@ int main(int argc, const char* argv[]) {
 
     // (Tenta) diminuir a influência dos boosts curtos e iniciais de processadores modernos
     if (!arg_dummy.isSet()) dummy_warm_hardware_benchmark();
+    Roofline roofline;
+    if (arg_roofline.isSet()) {
+        std::cout << "# Calibrating roofline...\n";
+        roofline = Roofline::calibrate(size_t(arg_rooflinemb.getValue()) << 20);
+        roofline.print(std::cout);
+    }
 
     // Contém os algoritmos filtrados pelo usuário (ou nenhum)
     std::unordered_set<std::string> filter(arg_filter.getValue().begin(), arg_filter.getValue().end());
+    std::unordered_set<std::string> ptypes(arg_ptype.getValue().begin(), arg_ptype.getValue().end());
 
     // Embaralha a ordem de invocação das implementações para garantir que não haja viés de ordem de execução, cache e boost
     auto_shuffle_(benchType);
@@ -93,24 +149,138 @@ int main(int argc, const char* argv[]) {
     // de escala de cinza; desconsiderando, portanto, o tempo gasto e a eficiência da biblioteca de carregamento
     // de imagens (e da gambiarra de copiar para uma estrutura própria do autor deste trabalho).
     std::cout << "# Started Simple Image Benchmark (" << GIT_COMMIT << ")\n";
+    std::cout << "# SIMD dispatch: " << simd::isa() << "\n";
+    if (arg_numareport.isSet() || arg_firsttouch.isSet() || Numa::fake_nodes)
+        std::cout << "# NUMA nodes: " << Numa::nodes() << (Numa::fake_nodes ? " (simulated)" : "") << "\n";
     int64_t global_total = 0;
 
+    // Nos modos por algoritmo, pipeline e streaming, os registros vão para stdout ou para o arquivo solicitado
+    std::ofstream output_file;
+    if (arg_output.isSet()) output_file.open(arg_output.getValue());
+    BenchWriter writer(arg_output.isSet() ? output_file : std::cout, BenchWriter::parseFormat(arg_format.getValue()));
+
+    // Resultados estruturados e comparação com uma referência
+    std::vector<BenchRecord> baseline, current;
+    if (arg_compare.isSet()) {
+        try {
+            baseline = results::load(arg_compare.getValue());
+        } catch (const std::exception& e) {
+            std::cerr << "--compare: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    std::ofstream results_file;
+    if (arg_results.isSet()) results_file.open(arg_results.getValue(), std::ios::app);
+    BenchWriter results_writer(results_file, BenchWriter::Format::JSON);
+
+    BenchOptions opts;
+    opts.repetitions = arg_reps.getValue();
+    opts.fused = arg_fused.isSet();
+    opts.dirty = arg_dirty.getValue();
+    opts.conversion = arg_convert.isSet();
+    opts.numa = arg_numareport.isSet();
+    opts.samples = arg_results.isSet() || arg_compare.isSet();
+    if (arg_roofline.isSet()) opts.roofline = &roofline;
+    std::unique_ptr<PerfCounters> perf;
+    if (arg_perf.isSet()) {
+        perf.reset(new PerfCounters());
+        if (!perf->available()) std::cout << "# Hardware counters unavailable (" << perf->getError() << ")\n";
+        else opts.perf = perf.get();
+    }
+
     // Após o cronometro começar, percorremos todas as imagens aplicando-as os algoritmos.
     for (const auto& bench : benchType) {
         const auto bname = bench->getDesc();
         if (!filter.empty() && filter.find(bname) == filter.end()) continue;
+        if (arg_ptype.isSet() ? ptypes.find(bench->pixelType()) == ptypes.end() : filter.empty() && bench->pixelType() != "u8") continue;
         if (arg_afilter.isSet()) {
             for (const auto& a : arg_afilter.getValue()) {
                 bench->setEnabled(a, true);
             }
         }
 
+        if (arg_tilew.getValue() || arg_tileh.getValue()) {
+            const auto t = bench->getTileSize();
+            bench->setTileSize({arg_tilew.getValue() ? arg_tilew.getValue() : t.width, arg_tileh.getValue() ? arg_tileh.getValue() : t.height});
+        }
+        if (arg_autotune.isSet()) {
+            const auto t = bench->autotuneTileSize(files.getValue().front().c_str());
+            std::cout << "# Autotuned tile size of " << bname << ": " << t.width << "x" << t.height << "\n";
+        }
+
         int64_t total = 0;
+        BufferPool::resetStats();
         std::cout << "# Evaluating " << bname << "\n";
+        if (arg_pipeline.isSet()) {
+            for (const auto& rec : bench->benchmark_pipeline(files.getValue(), arg_loaders.getValue(), arg_depth.getValue())) {
+                writer.write(rec);
+                if (rec.get("algorithm") == "pipeline") total += std::stoll(rec.get("kernel_time"));
+            }
+        }
+        if (arg_batch.isSet()) {
+            for (const auto& rec : bench->benchmark_batch(files.getValue(), opts)) {
+                writer.write(rec);
+                total += std::stoll(rec.get("median"));
+            }
+        }
         for (const auto& file : files.getValue()) {
-            total += bench->benchmark(file.c_str(), true);
+            if (arg_pipeline.isSet() || arg_batch.isSet()) {
+                break;
+            } else if (arg_stream.getValue()) {
+                try {
+                    for (const auto& rec : bench->benchmark_streaming(file.c_str(), arg_stream.getValue(), arg_streamout.getValue())) {
+                        writer.write(rec);
+                        if (rec.get("algorithm") == "streaming") total += std::stoll(rec.get("wall"));
+                    }
+                } catch (const std::exception& e) {
+                    std::cout << "# Streaming of " << file << " failed: " << e.what() << "\n";
+                }
+            } else if (arg_peralgo.isSet()) {
+                // Sem --thread-sweep, uma única rodada com a configuração atual
+                const std::vector<uint> sweep = arg_sweep.isSet() ? arg_sweep.getValue() : std::vector<uint>{0};
+                // Com --pitch-compare, cada rodada se repete com linhas compactas e com preenchimento
+                const std::vector<size_t> aligns = arg_pitchcmp.isSet() ? std::vector<size_t>{0, row_align ? row_align : 64} : std::vector<size_t>{row_align};
+                // Com --traversal-compare, também se repete com o percurso genérico (antes) e o do layout (depois)
+                const std::vector<bool> orders = arg_travcmp.isSet() ? std::vector<bool>{false, true} : std::vector<bool>{true};
+                for (size_t run = 0; run < aligns.size()*orders.size(); run++) {
+                    const size_t align = aligns[run/orders.size()];
+                    const bool layout_order = orders[run % orders.size()];
+                    RowPitch::alignment = align;
+                    TraversalOptions::layout_order = layout_order;
+                    std::unordered_map<std::string, std::pair<double, uint>> base; // algoritmo -> (mediana, threads) da primeira rodada
+                    for (const auto n : sweep) {
+                        if (arg_sweep.isSet()) parallel::configure(backend, n, arg_pin.isSet());
+                        for (auto& rec : bench->benchmark_algorithms(file.c_str(), opts)) {
+                            if (arg_sweep.isSet()) {
+                                const double median = std::stod(rec.get("median"));
+                                const auto b = base.emplace(rec.get("algorithm"), std::make_pair(median, parallel::threads())).first->second;
+                                const double speedup = median > 0 ? b.first/median : 0;
+                                rec.set("speedup", speedup).set("efficiency", speedup*b.second/parallel::threads());
+                            }
+                            if (arg_pitchcmp.isSet() || row_align) rec.set("row_align", align);
+                            if (arg_travcmp.isSet()) rec.set("traversal", layout_order ? "layout" : "generic");
+                            writer.write(rec);
+                            if (arg_results.isSet()) {
+                                BenchRecord keyed;
+                                keyed.set("commit", GIT_COMMIT);
+                                keyed.fields.insert(keyed.fields.end(), rec.fields.begin(), rec.fields.end());
+                                results_writer.write(keyed);
+                            }
+                            if (arg_compare.isSet()) current.push_back(rec);
+                            total += std::stoll(rec.get("median"));
+                        }
+                    }
+                }
+                RowPitch::alignment = row_align;
+                TraversalOptions::layout_order = true;
+            } else {
+                total += bench->benchmark(file.c_str(), true);
+            }
         }
         global_total += total;
+        const auto alloc = BufferPool::stats();
+        std::cout << "# Allocations of " << bname << ": " << alloc.allocations << " from the system, " << alloc.reuses
+                  << " reused, " << alloc.time << " " STRINGIFY(CLOCK_PRECISION) "\n";
         std::cout << "# Evaluation of " << bname << " finished with a total of " << total << " " STRINGIFY(CLOCK_PRECISION) "\n";
     }
 
@@ -121,6 +291,19 @@ int main(int argc, const char* argv[]) {
     for (auto& bench : benchType) {
         delete bench;
     }
+    BufferPool::trim();
+
+    if (arg_compare.isSet()) {
+        results::Summary summary;
+        BenchWriter report(std::cout, BenchWriter::parseFormat(arg_format.getValue()));
+        for (const auto& rec : results::compare(baseline, current, arg_alpha.getValue(), arg_threshold.getValue()/100, summary)) {
+            report.write(rec);
+        }
+        std::cout << "# Comparison with " << arg_compare.getValue() << ": " << summary.regressions << " regressions, "
+                  << summary.improvements << " improvements, " << summary.unchanged << " unchanged, "
+                  << summary.missing << " without baseline\n";
+        if (summary.regressions) return 1;
+    }
 
     return 0; // TODO: FSANITIZE
 }